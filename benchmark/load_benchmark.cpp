@@ -0,0 +1,104 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <core/btree.h>
+#include <core/dbfile.h>
+#include <core/row.h>
+#include <unistd.h>
+
+// load sorted rows with one insert per row, into trees of rows sized at
+// runtime and of fixed rows, in batches of rows and with bulk_load.
+// usage: load_benchmark [num_keys] [path]
+
+static void make_row(uint32_t key, UserInfo & row)
+{
+    std::string name = std::to_string(key);
+    row = UserInfo(key, name.c_str(), name.c_str());
+}
+
+// Tree: a tree of rows sized at runtime or of fixed UserInfo rows
+template <typename Tree>
+static void insert_rows(const char * method, int n, const std::string & path, const PagerOptions & options)
+{
+    // every tree starts from a new file
+    unlink(path.c_str());
+    UserInfo row;
+    auto start = std::chrono::steady_clock::now();
+    Tree btree(path, 'c', UserInfo().get_row_byte(), 10, 10, options);
+    for (int i = 0; i < n; ++i)
+    {
+        make_row(i, row);
+        btree.insert(i, &row);
+    }
+    btree.commit();
+    auto end = std::chrono::steady_clock::now();
+    printf("%-10s %10d %10llu %12.1f\n", method, n, (unsigned long long)btree.get_total_page(),
+        std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+// insert the rows in batches of batch_size rows
+static void insert_batches(int n, int batch_size, const std::string & path, const PagerOptions & options)
+{
+    unlink(path.c_str());
+    std::vector<UserInfo> rows(batch_size);
+    std::vector<BPlusTree::BatchEntry> batch;
+    auto start = std::chrono::steady_clock::now();
+    BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 10, 10, options);
+    for (int i = 0; i < n; i += batch_size)
+    {
+        batch.clear();
+        for (int k = 0; k < batch_size && i + k < n; ++k)
+        {
+            make_row(i + k, rows[k]);
+            batch.push_back({(uint32_t)(i + k), &rows[k]});
+        }
+        btree.insert_batch(batch);
+    }
+    btree.commit();
+    auto end = std::chrono::steady_clock::now();
+    std::string method = "batch " + std::to_string(batch_size);
+    printf("%-10s %10d %10llu %12.1f\n", method.c_str(), n, (unsigned long long)btree.get_total_page(),
+        std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+int main(int argc, char * argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+    std::string path = argc > 2 ? argv[2] : "/tmp/load_benchmark";
+
+    PagerOptions options;
+    options.pool_pages = 1024;
+    UserInfo row;
+
+    printf("%-10s %10s %10s %12s\n", "method", "rows", "pages", "time (ms)");
+    insert_rows<BPlusTree>("insert", n, path, options);
+    insert_rows<UserInfoBPlusTree>("insert fix", n, path, options);
+    insert_batches(n, 4096, path, options);
+
+    for (double fill_factor : {1.0, 0.7})
+    {
+        auto start = std::chrono::steady_clock::now();
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 10, 10, options);
+        int i = 0;
+        btree.bulk_load(
+            [&i, n, &row](uint32_t & key, Row *& out)
+            {
+                if (i == n)
+                    return false;
+                key = i++;
+                make_row(key, row);
+                out = &row;
+                return true;
+            },
+            fill_factor);
+        auto end = std::chrono::steady_clock::now();
+        std::string method = "bulk " + std::to_string((int)(fill_factor * 100)) + "%";
+        printf("%-10s %10d %10llu %12.1f\n", method.c_str(), n, (unsigned long long)btree.get_total_page(),
+            std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    unlink(path.c_str());
+    return 0;
+}
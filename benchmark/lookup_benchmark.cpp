@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <core/btree.h>
+#include <core/dbfile.h>
+#include <core/key_search.h>
+#include <core/row.h>
+#include <unistd.h>
+
+// point lookups on a tree held by the buffer pool with each key search
+// implementation the cpu supports, then batches of lookups with a find per
+// key and with multi_find, then lookups of threads on a tree of the mmap
+// backend, then searches of a single full inner node. every heap
+// allocation of the process is counted so that the lookup loop can prove
+// it has none.
+// usage: lookup_benchmark [num_keys] [path]
+
+static std::atomic<size_t> num_allocations(0);
+
+void * operator new(size_t size)
+{
+    num_allocations += 1;
+    if (void * ptr = malloc(size == 0 ? 1 : size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void * ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void * ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+// keys 0, 2, ..., 2 * (n - 1)
+static void load_keys(BPlusTree & btree, int n)
+{
+    int i = 0;
+    UserInfo row;
+    btree.bulk_load(
+        [&i, n, &row](uint32_t & key, Row *& out)
+        {
+            if (i == n)
+                return false;
+            key = 2 * i++;
+            std::string name = std::to_string(key);
+            row = UserInfo(key, name.c_str(), name.c_str());
+            out = &row;
+            return true;
+        });
+}
+
+int main(int argc, char * argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    std::string path = argc > 2 ? argv[2] : "/tmp/lookup_benchmark";
+
+    // nodes as full as a page allows, the pool holds the whole tree
+    PagerOptions options;
+    options.pool_pages = n / 25 + 1024;
+    BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 1000, 1000, options);
+    load_keys(btree, n);
+
+    // the first pass loads every page into the pool
+    for (int k = 0; k < 2 * n; ++k)
+        btree.find(k);
+
+    // hits on even keys and misses on odd ones in a scattered order
+    size_t num_lookups = 4 * (size_t)n, total_allocations = 0;
+    printf("%-8s %10s %10s %14s %12s\n", "search", "lookups", "found", "ns / lookup", "allocations");
+    for (auto isa : {KeySearchIsa::SCALAR, KeySearchIsa::SSE42, KeySearchIsa::AVX2})
+    {
+        if (!set_key_search_isa(isa))
+            continue;
+
+        size_t num_found = 0;
+        size_t allocations_before = num_allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < num_lookups; ++k)
+            num_found += btree.find((uint32_t)((k * 7919) % (2 * n))).is_exist;
+        auto end = std::chrono::steady_clock::now();
+        size_t allocations = num_allocations - allocations_before;
+        total_allocations += allocations;
+
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        printf("%-8s %10zu %10zu %14.1f %12zu\n", key_search_isa_name(isa), num_lookups, num_found, ns / num_lookups, allocations);
+    }
+
+    // the same scattered keys in batches
+    printf("\n%-10s %8s %10s %14s\n", "method", "batch", "found", "ns / lookup");
+    for (size_t batch_size : {16, 256, 4096})
+    {
+        std::vector<uint32_t> batch(batch_size);
+        size_t num_batches = num_lookups / batch_size;
+        for (bool multi : {false, true})
+        {
+            size_t num_found = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t b = 0; b < num_batches; ++b)
+            {
+                for (size_t k = 0; k < batch_size; ++k)
+                    batch[k] = (uint32_t)(((b * batch_size + k) * 7919) % (2 * n));
+                if (multi)
+                {
+                    for (auto & location : btree.multi_find(batch))
+                        num_found += location.is_exist;
+                }
+                else
+                {
+                    for (auto key : batch)
+                        num_found += btree.find(key).is_exist;
+                }
+            }
+            auto end = std::chrono::steady_clock::now();
+            double ns = std::chrono::duration<double, std::nano>(end - start).count();
+            printf("%-10s %8zu %10zu %14.1f\n", multi ? "multi_find" : "find", batch_size, num_found, ns / (num_batches * batch_size));
+        }
+    }
+
+    // readers of a mapped tree validate node versions and write nothing
+    // shared, so lookups of threads run side by side
+    {
+        std::string mmap_path = path + "-mmap";
+        PagerOptions mmap_options;
+        mmap_options.backend = PagerBackend::MMAP;
+        BPlusTree mapped(mmap_path, 'c', UserInfo().get_row_byte(), 1000, 1000, mmap_options);
+        load_keys(mapped, n);
+
+        unsigned max_threads = std::max(8u, std::thread::hardware_concurrency());
+        printf("\n%-8s %12s %10s %16s\n", "threads", "lookups", "found", "lookups / us");
+        for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+        {
+            std::atomic<size_t> num_found(0);
+            auto lookup = [&](unsigned t)
+            {
+                char row[UserInfo::ROW_BYTE];
+                size_t found = 0;
+                for (size_t k = t; k < num_lookups; k += num_threads)
+                    found += mapped.find_row((uint32_t)((k * 7919) % (2 * n)), row);
+                num_found += found;
+            };
+
+            auto start = std::chrono::steady_clock::now();
+            std::vector<std::thread> threads;
+            for (unsigned t = 0; t < num_threads; ++t)
+                threads.emplace_back(lookup, t);
+            for (auto & thread : threads)
+                thread.join();
+            auto end = std::chrono::steady_clock::now();
+            double us = std::chrono::duration<double, std::micro>(end - start).count();
+            printf("%-8u %12zu %10zu %16.2f\n", num_threads, num_lookups, num_found.load(), num_lookups / us);
+        }
+        unlink(mmap_path.c_str());
+    }
+
+    // keys of a full inner node, the node stays in the cache
+    std::vector<uint32_t> keys(NodeLayout<uint32_t>::INTERNAL_MAX_KEYS);
+    for (size_t k = 0; k < keys.size(); ++k)
+        keys[k] = 3 * k;
+    size_t num_searches = 10000000, checksum = 0;
+    printf("\n%-8s %10s %14s\n", "search", "keys", "ns / search");
+    for (auto isa : {KeySearchIsa::SCALAR, KeySearchIsa::SSE42, KeySearchIsa::AVX2})
+    {
+        if (!set_key_search_isa(isa))
+            continue;
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t k = 0; k < num_searches; ++k)
+            checksum += lower_bound_keys(keys.data(), keys.size(), (uint32_t)((k * 7919) % (3 * keys.size())));
+        auto end = std::chrono::steady_clock::now();
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        printf("%-8s %10zu %14.2f\n", key_search_isa_name(isa), keys.size(), ns / num_searches);
+    }
+    set_key_search_isa(best_key_search_isa());
+    if (checksum == 0)
+        printf("no key found\n");
+
+    unlink(path.c_str());
+    return total_allocations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
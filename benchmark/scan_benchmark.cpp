@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <core/btree.h>
+#include <core/dbfile.h>
+#include <core/row.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// range queries over a tree which is not in any cache, with and without
+// readahead, then full scans of a mapped tree by the threads of a parallel
+// scan. usage: scan_benchmark [num_keys] [path]
+
+static void build_tree(const std::string & path, int n, bool sequential, const PagerOptions & options = PagerOptions())
+{
+    BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 10, 10, options);
+    for (int i = 0; i < n; ++i)
+    {
+        int key = sequential ? i : (int)(((int64_t)i * 7919) % n);
+        std::string name = std::to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        btree.insert(key, &row);
+    }
+}
+
+// drop the pages of the file from the kernel page cache
+static void drop_cache(const std::string & path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        perror("open benchmark file error");
+        exit(EXIT_FAILURE);
+    }
+#ifdef POSIX_FADV_DONTNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+#endif
+    close(fd);
+}
+
+static double scan(const std::string & path, IoEngine engine, bool direct_io, size_t readahead_pages, uint32_t min_key, uint32_t max_key, size_t & num_rows)
+{
+    drop_cache(path);
+
+    PagerOptions options;
+    options.io_engine = engine;
+    options.pool_pages = 256;
+    options.readahead_pages = readahead_pages;
+    options.direct_io = direct_io;
+
+    auto start = std::chrono::steady_clock::now();
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 10, 10, options);
+    num_rows = btree.select_cell(min_key, max_key).size();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static const char * engine_name(IoEngine engine, bool direct_io)
+{
+    if (engine == IoEngine::SYNC)
+        return direct_io ? "sync+direct" : "sync";
+    return direct_io ? "async+direct" : "async";
+}
+
+int main(int argc, char * argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 200000;
+    std::string path = argc > 2 ? argv[2] : "/tmp/scan_benchmark";
+
+    printf("%-10s %-13s %-6s %9s %9s %12s %12s\n", "insert", "engine", "range", "rows", "readahead", "cold (ms)", "speedup");
+    for (bool sequential : {true, false})
+    {
+        build_tree(path, n, sequential);
+        for (auto engine : {IoEngine::SYNC, IoEngine::ASYNC})
+        for (bool direct_io : {false, true})
+        {
+            for (double fraction : {1.0, 0.1})
+            {
+                uint32_t min_key = n / 3;
+                uint32_t max_key = min_key + (uint32_t)(n * fraction);
+                if (fraction == 1.0)
+                    min_key = 0, max_key = n;
+
+                size_t num_rows = 0;
+                double baseline = scan(path, engine, direct_io, 0, min_key, max_key, num_rows);
+                printf("%-10s %-13s %5.0f%% %9zu %9d %12.1f\n", sequential ? "sequential" : "random",
+                    engine_name(engine, direct_io), fraction * 100, num_rows, 0, baseline);
+
+                double elapsed = scan(path, engine, direct_io, 32, min_key, max_key, num_rows);
+                printf("%-10s %-13s %5.0f%% %9zu %9d %12.1f %11.2fx\n", sequential ? "sequential" : "random",
+                    engine_name(engine, direct_io), fraction * 100, num_rows, 32, elapsed, baseline / elapsed);
+            }
+        }
+    }
+
+    // the tree stays in the page cache, the scan is bound by the cpus. an
+    // unordered scan sums the keys of each thread apart
+    PagerOptions mmap_options;
+    mmap_options.backend = PagerBackend::MMAP;
+    build_tree(path, n, false, mmap_options);
+    {
+        BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 10, 10, mmap_options);
+        unsigned max_threads = std::max(8u, std::thread::hardware_concurrency());
+        printf("\n%-8s %-10s %9s %12s %12s\n", "threads", "order", "rows", "warm (ms)", "rows / us");
+        for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+        {
+            WorkStealingPool pool(num_threads);
+            for (bool ordered : {true, false})
+            {
+                // a cache line of sums per thread
+                std::vector<uint64_t> sums(8 * num_threads);
+                auto start = std::chrono::steady_clock::now();
+                size_t num_rows = btree.parallel_scan(0, UINT32_MAX, pool, ordered, [&](unsigned worker, uint32_t key, const void *) {
+                    sums[8 * worker] += key;
+                    return true;
+                });
+                auto end = std::chrono::steady_clock::now();
+                double ms = std::chrono::duration<double, std::milli>(end - start).count();
+                printf("%-8u %-10s %9zu %12.1f %12.2f\n", num_threads, ordered ? "ordered" : "unordered", num_rows, ms, num_rows / (ms * 1000));
+            }
+        }
+    }
+
+    unlink(path.c_str());
+    return 0;
+}
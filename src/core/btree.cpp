@@ -1,4 +1,5 @@
 #include "btree.h"
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <exception>
@@ -9,34 +10,42 @@
 #include "dbfile.h"
 using namespace std;
 
+// a tree of fixed rows holds rows of its size only, checked before the file is opened
+static uint32_t check_row_size(uint32_t row_size, uint32_t fixed_row_size)
+{
+    if (fixed_row_size != DYNAMIC_ROW_SIZE && row_size != fixed_row_size)
+        throw std::runtime_error("row size " + to_string(row_size) + " of a tree of rows of " + to_string(fixed_row_size) + " bytes");
+    return row_size;
+}
 
-unique_ptr<BtreeNode> BtreeNode::LoadNodeFrom(void * page)
+template <typename Key, uint32_t RowSize>
+BasicBPlusTree<Key, RowSize>::BasicBPlusTree(
+    const string & path,
+    char mode,
+    uint32_t rsize,
+    uint32_t leaf_node_load,
+    uint32_t inner_node_load,
+    const PagerOptions & options,
+    const WalOptions & wal_options)
+    : row_size(check_row_size(rsize, RowSize)), pager(path, mode, options), root_id(PAGE_ID_INVALID), leaf_cells(row_size), root_changed(false),
+      meta_lsn(0), leaf_load(leaf_node_load), inner_node_load(inner_node_load), last_leaf(PAGE_ID_INVALID)
 {
-    // build root node according to its type
-    auto node_type = get_node_type_from(page);
-    std::unique_ptr<BtreeNode> node;
-    switch (node_type)
+    if (wal_options.enabled)
     {
-        case NODE_TYPE_INNER:
-            node = make_unique<InternalNode>(page, false);
-            break;
+        // pages of a mapping are written back by the kernel at any time
+        if (options.backend == PagerBackend::MMAP)
+        {
+            fprintf(stderr, "write ahead log requires the buffer pool backend\n");
+            exit(EXIT_FAILURE);
+        }
 
-        case NODE_TYPE_LEAF:
-            node = make_unique<LeafNode>(page);
-            break;
+        wal = make_unique<WriteAheadLog>(path + "-wal", mode, wal_options);
 
-        default:
-            throw std::runtime_error("Unknown Node Type");
-            break;
+        // wal rule: a page reaches disk after the groups which changed it
+        pager.set_write_barrier(
+            [this](const void * page) { wal->flush_to(page != nullptr ? Node::get_page_lsn_from(page) : meta_lsn); });
     }
 
-    return node;
-}
-
-
-BPlusTree::BPlusTree(const string & path, char mode, uint32_t rsize, uint32_t leaf_node_load, uint32_t inner_node_load)
-    : pager(path, mode), leaf_load(leaf_node_load), inner_node_load(inner_node_load), row_size(rsize)
-{
     // when start from empty tree one must init the root page to a leaf node
     if (mode == 'c')
     {
@@ -44,17 +53,19 @@ BPlusTree::BPlusTree(const string & path, char mode, uint32_t rsize, uint32_t le
         auto pid = pager.allocate_page(root_page);
         // root = unique_ptr<LeafNode>(new LeafNode(root_page, row_size));
         auto leaf = make_unique<LeafNode>(root_page, row_size);
-
-        // set parent of root to invalid
-        leaf->parent() = NODE_PARENT_INVALID;
         update_root(pid);
+        log_operation();
     }
     // when the tree is not first open we load its page from disk
     else
     {
-        // warning uint64 to int
-        root_page = pager.get_page(get_root_page());
-        root = BtreeNode::LoadNodeFrom(root_page);
+        if (wal != nullptr)
+            recover();
+
+        // root page is pinned in memory during the life time of the tree
+        root_page = pager.pin_page(get_root_page());
+        root = load_node(root_page);
+        root_id.store(get_root_page(), std::memory_order_release);
     }
 
     // check root bit
@@ -62,78 +73,129 @@ BPlusTree::BPlusTree(const string & path, char mode, uint32_t rsize, uint32_t le
     // assert(root->get_num_keys() > 0);
 }
 
-uint64_t BPlusTree::get_root_page() const
+template <typename Key, uint32_t RowSize>
+BasicBPlusTree<Key, RowSize>::~BasicBPlusTree()
+{
+    if (wal == nullptr)
+        return;
+
+    checkpoint();
+    pager.set_write_barrier(nullptr);
+}
+
+template <typename Key, uint32_t RowSize>
+uint64_t BasicBPlusTree<Key, RowSize>::get_root_page() const
 {
     uint64_t root_page = pager.get_root_page();
     // logic check: root_page is correct
     return root_page;
 }
 
-uint64_t BPlusTree::get_total_page() const
+template <typename Key, uint32_t RowSize>
+uint64_t BasicBPlusTree<Key, RowSize>::get_total_page() const
 {
     return pager.num_pages();
 }
 
-void BPlusTree::update_root(uint64_t page_id)
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::update_root(uint64_t page_id)
 {
     // change bit of old root
     if (root != nullptr)
+    {
+        auto old_root = pager.get_root_page();
+        touch(old_root);
         root->set_root(false);
+        pager.unpin_page(old_root);
+    }
 
+    // readers which took the old root find it changed once it is unlocked
     pager.set_root_page(page_id);
-    root_page = pager.get_page(page_id);
-    root = BtreeNode::LoadNodeFrom(root_page);
+    root_id.store(page_id, std::memory_order_release);
+    last_leaf = PAGE_ID_INVALID;
+    root_page = pager.pin_page(page_id);
+    root = load_node(root_page);
     root->set_root(true);
-    root->parent() = NODE_PARENT_INVALID;
+    touch(page_id);
+    root_changed = true;
 }
 
 // assume: key is not duplicated
-BPlusTree::InsertStatus BPlusTree::insert(uint32_t key, Row * row)
+template <typename Key, uint32_t RowSize>
+typename BasicBPlusTree<Key, RowSize>::InsertStatus BasicBPlusTree<Key, RowSize>::insert(Key key, Row * row)
 {
+    Traits::check(key);
+    lock_guard<mutex> writer(writer_mutex);
+
     // find the leaf page to insert current key and row
-    auto keyLocation = find(key);
+    DescentPath path;
+    auto keyLocation = find_for_insert(key, path);
 
     // handle the case: key duplicated use status
     if (keyLocation.is_exist)
         return InsertStatus::FAIL_DUPLICATE_KEY;
 
     // try into insert the key to the leaf
+    // the leaf is pinned since splitting it allocates new pages
     auto page_id = keyLocation.page_id;
-    LeafNode leaf(pager.get_page(page_id));
+    PageGuard leaf_guard(pager, page_id);
+    LeafNode leaf(leaf_guard.data);
     leaf.set_node_load(min(leaf.num_max_cell, leaf_load));
+    touch(page_id);
+
+    // keys mostly come in increasing order: an append to the last leaf
+    // keeps the path for the next one, and splits of the right edge leave
+    // the left nodes 90% loaded
+    bool append = leaf.next_leaf() == PAGE_ID_INVALID && keyLocation.row_id == (int)leaf.num_cells();
 
     if (!leaf.isFull())
     {
         leaf.insert(key, row);
+        log_operation(leaf.get_cell(leaf.search_key_position(key)));
+        checkpoint_step();
+        if (append)
+        {
+            last_leaf = page_id;
+            last_leaf_path = std::move(path);
+        }
         return InsertStatus::SUCCESS;
     }
 
     // handle the case of leaf overflow
     void * new_page = nullptr;
+    auto old_next = leaf.next_leaf();
     auto new_page_id = pager.allocate_page(new_page);
-    auto key_upward = leaf.insert_and_split(key, row, new_page);
-    // auto tmp = get_node_by(new_page_id);
+    auto new_leaf_id = new_page_id;
+    touch(new_page_id);
+    auto key_upward = leaf.insert_and_split(key, row, new_page, page_id, new_page_id, append);
+
+    // the old right sibling links back to the new leaf
+    if (old_next != PAGE_ID_INVALID)
+    {
+        PageGuard next_guard(pager, old_next);
+        touch(old_next);
+        LeafNode(next_guard.data).prev_leaf() = new_page_id;
+    }
 
     // post the overflow on inner node
-    // now one shall insert (key_upward, left, right) to its parent node
+    // now one shall insert (key_upward, left, right) to its parent node,
+    // parents are taken from the path of the descent. on an append the
+    // path is updated to lead to the new last leaf
     auto left = page_id;
     auto right = new_page_id;
-    auto parent = leaf.parent();
     bool jobDone = false;
-    while (parent != NODE_PARENT_INVALID && !jobDone)
+    for (size_t level = path.size(); level > 0 && !jobDone; --level)
     {
-        InternalNode parentNode(pager.get_page(parent));
+        auto parent = path[level - 1].page_id;
+        PageGuard parent_guard(pager, parent);
+        InternalNode parentNode(parent_guard.data);
         parentNode.set_node_load(min(parentNode.num_max_keys, inner_node_load));
+        touch(parent);
         // if parent node not full
         if (!parentNode.isFull())
         {
             parentNode.insert(key_upward, left, right);
-
-            // link both left and right's parent to current parentNode
-            // link_to(left, parent);
-            assert(get_node_by(left)->parent() == parent);
-            link_to(right, parent);
-
+            path[level - 1].slot += 1;
             jobDone = true;
         }
         // else
@@ -141,38 +203,14 @@ BPlusTree::InsertStatus BPlusTree::insert(uint32_t key, Row * row)
         {
             new_page = nullptr;
             new_page_id = pager.allocate_page(new_page);
-            // when inner node splits, the parent link shall move too
-            auto pivot = parentNode.insert_and_split(key_upward, left, right, new_page);
-            if (key_upward < pivot)
-            {
-                link_to(left, parent);
-                link_to(right, parent);
-            }
-            else if (key_upward > pivot)
-            {
-                link_to(left, new_page_id);
-                link_to(right, new_page_id);
-            }
-            // key_upard == pivot
-            else
-            {
-                link_to(left, parent);
-                link_to(right, new_page_id);
-            }
-
-            // reconfigure link of right page
-            auto newRightNode = get_node_by(new_page_id);
-            InternalNode* newRightNodeHandler = dynamic_cast<InternalNode*>(newRightNode.get());
-            for (int r=0; r <= newRightNodeHandler->num_keys(); ++r)
-            {
-                auto child = get_node_by(newRightNodeHandler->get_child(r));
-                child->parent() = new_page_id;
-            }
+            touch(new_page_id);
+            // children moved to the new node are not changed
+            auto pivot = parentNode.insert_and_split(key_upward, left, right, new_page, append);
+            path[level - 1] = {new_page_id, (int)InternalNode(new_page).num_keys()};
 
             key_upward = pivot;
             left = parent;
             right = new_page_id;
-            parent = parentNode.parent();
         }
     }
 
@@ -185,84 +223,1454 @@ BPlusTree::InsertStatus BPlusTree::insert(uint32_t key, Row * row)
         // new an empty root node
         new_page = nullptr;
         new_page_id = pager.allocate_page(new_page);
+        touch(new_page_id);
         InternalNode new_root(new_page, true);
 
         // insert (key_upward, left, right) to new root
         new_root.insert(key_upward, left, right);
-        link_to(left, new_page_id);
-        link_to(right, new_page_id);
 
         // change root of the tree
         update_root(new_page_id);
+        path.insert(path.begin(), {new_page_id, 1});
     }
 
+    log_operation();
+    checkpoint_step();
+    last_leaf = append ? new_leaf_id : PAGE_ID_INVALID;
+    if (append)
+        last_leaf_path = std::move(path);
     return InsertStatus::SUCCESS;
 }
 
-void BPlusTree::link_to(uint64_t child, uint64_t parent)
+template <typename Key, uint32_t RowSize>
+KeyLocation BasicBPlusTree<Key, RowSize>::find_for_insert(Key key, DescentPath & path)
 {
-    auto childNode = BtreeNode::LoadNodeFrom(pager.get_page(child));
-    childNode->parent() = parent;
+    if (last_leaf != PAGE_ID_INVALID)
+    {
+        BasicLeafView<Key> leaf(pager.get_page(last_leaf));
+        uint32_t n = leaf.num_cells();
+        if (n > 0 && leaf.key(n - 1) < key)
+        {
+            path = last_leaf_path;
+            return KeyLocation(last_leaf, n, false);
+        }
+    }
+    return find(key, &path);
 }
 
-KeyLocation BPlusTree::find(uint32_t key)
+// leaves added by one step of a batch insert at most, pages changed by a
+// step stay pinned until it is logged
+static const uint32_t BATCH_STEP_NEW_LEAVES = 4;
+
+template <typename Key, uint32_t RowSize>
+size_t BasicBPlusTree<Key, RowSize>::insert_batch(vector<BatchEntry> batch)
 {
-    uint64_t page_id = pager.get_root_page();
-    auto curr = BtreeNode::LoadNodeFrom(root_page);
+    for (auto & entry : batch)
+        Traits::check(entry.first);
+    lock_guard<mutex> writer(writer_mutex);
+    last_leaf = PAGE_ID_INVALID;
+    stable_sort(batch.begin(), batch.end(), [](const BatchEntry & a, const BatchEntry & b) { return a.first < b.first; });
+
+    using Layout = NodeLayout<Key>;
+    size_t step_rows = BATCH_STEP_NEW_LEAVES * min(Layout::leaf_capacity(Layout::KEY_SIZE + row_size), leaf_load);
+
+    size_t inserted = 0;
+    vector<SplitEntry> splits;
+    for (size_t begin = 0, end; begin < batch.size(); begin = end)
+    {
+        DescentPath path;
+        auto location = find(batch[begin].first, &path);
+
+        // the leaf holds the keys up to the key right of the deepest child
+        // of the path which is not the last child of its node
+        end = batch.size();
+        for (auto entry = path.rbegin(); entry != path.rend(); ++entry)
+        {
+            PageGuard guard(pager, entry->page_id);
+            BasicInnerView<Key> inner(guard.data);
+            if (entry->slot < (int)inner.num_keys())
+            {
+                Key max_key = inner.key(entry->slot);
+                auto last = upper_bound(batch.begin() + begin, batch.end(), max_key,
+                    [](const Key & key, const BatchEntry & entry) { return key < entry.first; });
+                end = last - batch.begin();
+                break;
+            }
+        }
+        end = min(end, begin + step_rows);
+
+        inserted += insert_into_leaf(location.page_id, batch.data() + begin, batch.data() + end, splits);
+
+        // post the new nodes along the path, when the root splits new
+        // roots are put above it until nothing is left
+        for (; !splits.empty() && !path.empty(); path.pop_back())
+            insert_into_inner(path.back().page_id, path.back().slot, splits);
+
+        uint64_t top = get_root_page();
+        bool root_split = !splits.empty();
+        while (!splits.empty())
+        {
+            void * new_page = nullptr;
+            auto new_page_id = pager.allocate_page(new_page);
+            touch(new_page_id);
+            {
+                PageGuard guard(pager, new_page_id);
+                InternalNode new_root(guard.data, true);
+                new_root.get_child(0) = top;
+            }
+            insert_into_inner(new_page_id, 0, splits);
+            top = new_page_id;
+        }
+        if (root_split)
+            update_root(top);
+
+        log_operation();
+        checkpoint_step();
+    }
+    return inserted;
+}
+
+template <typename Key, uint32_t RowSize>
+size_t BasicBPlusTree<Key, RowSize>::insert_into_leaf(
+    uint64_t page_id, const BatchEntry * begin, const BatchEntry * end, vector<SplitEntry> & splits)
+{
+    PageGuard leaf_guard(pager, page_id);
+    LeafNode leaf(leaf_guard.data);
+    uint32_t load = min(leaf.num_max_cell, leaf_load);
+    leaf.set_node_load(load);
+
+    // rows whose key is neither in the leaf nor taken by a former row
+    vector<const BatchEntry *> rows;
+    for (auto entry = begin; entry != end; ++entry)
+    {
+        if (!rows.empty() && rows.back()->first == entry->first)
+            continue;
+        int pos = leaf.search_key_position(entry->first);
+        if (pos >= 0 && Key(leaf.get_key(pos)) == entry->first)
+            continue;
+        rows.push_back(entry);
+    }
+    if (rows.empty())
+        return 0;
+
+    touch(page_id);
+    uint32_t n = leaf.num_cells();
+    uint32_t total = n + rows.size();
+    if (total <= load)
+    {
+        for (auto entry : rows)
+            leaf.insert(entry->first, entry->second);
+        return rows.size();
+    }
+
+    // merge the cells of the leaf and the new rows in key order
+    vector<char> cells((size_t)total * leaf.cell_size);
+    auto cell_at = [&](uint32_t k) { return cells.data() + (size_t)k * leaf.cell_size; };
+    for (uint32_t i = 0, j = 0, k = 0; k < total; ++k)
+    {
+        if (j == rows.size() || (i < n && Key(leaf.get_key(i)) < rows[j]->first))
+        {
+            memcpy(cell_at(k), leaf.get_cell(i++), leaf.cell_size);
+            continue;
+        }
+        *LeafNode::extract_key(cell_at(k)) = rows[j]->first;
+        rows[j++]->second->serialize(LeafNode::extract_value(cell_at(k)));
+    }
+    leaf.remove_cells(0, n);
+
+    // as few leaves as hold the cells, loaded evenly so that each is at
+    // least half loaded. the leaf keeps the first cells
+    uint32_t num_leaves = (total + load - 1) / load;
+    uint32_t k = 0;
+    auto fill = [&](LeafNode & node, uint32_t index)
+    {
+        for (uint32_t last = k + total / num_leaves + (index < total % num_leaves); k < last; ++k)
+            node.insert_cell(cell_at(k));
+    };
+    fill(leaf, 0);
+
+    auto old_next = leaf.next_leaf();
+    uint64_t prev_id = page_id;
+    void * prev_page = leaf_guard.data;
+    unique_ptr<PageGuard> prev_guard;
+    for (uint32_t index = 1; index < num_leaves; ++index)
+    {
+        auto separator = Traits::separator(*LeafNode::extract_key(cell_at(k - 1)), *LeafNode::extract_key(cell_at(k)));
+        void * new_page = nullptr;
+        auto new_page_id = pager.allocate_page(new_page);
+        touch(new_page_id);
+        auto guard = make_unique<PageGuard>(pager, new_page_id);
+        LeafNode new_leaf(guard->data, row_size);
+        fill(new_leaf, index);
+
+        new_leaf.prev_leaf() = prev_id;
+        LeafNode(prev_page).next_leaf() = new_page_id;
+        splits.push_back({separator, new_page_id});
+        prev_guard = move(guard);
+        prev_id = new_page_id;
+        prev_page = prev_guard->data;
+    }
+
+    // the old right sibling links back to the last new leaf
+    LeafNode(prev_page).next_leaf() = old_next;
+    if (old_next != PAGE_ID_INVALID)
+    {
+        PageGuard next_guard(pager, old_next);
+        touch(old_next);
+        LeafNode(next_guard.data).prev_leaf() = prev_id;
+    }
+    return rows.size();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::insert_into_inner(uint64_t page_id, int slot, vector<SplitEntry> & splits)
+{
+    PageGuard guard(pager, page_id);
+    InternalNode node(guard.data);
+    uint32_t load = min(node.num_max_keys, inner_node_load);
+    node.set_node_load(load);
+    touch(page_id);
+
+    // the new children come right after child slot, the keys and children
+    // behind it move together
+    uint32_t n = node.num_keys(), m = splits.size();
+    uint64_t * children = &node.get_child(0);
+    if (n + m <= load)
+    {
+        memmove(node.keys() + slot + m, node.keys() + slot, (n - slot) * InternalNode::Layout::KEY_SIZE);
+        memmove(children + slot + 1 + m, children + slot + 1, (n - slot) * INTERNAL_NODE_CHILD_SIZE);
+        for (uint32_t i = 0; i < m; ++i)
+        {
+            node.keys()[slot + i] = Key(splits[i].key);
+            children[slot + 1 + i] = splits[i].page_id;
+        }
+        node.num_keys() = n + m;
+        splits.clear();
+        return;
+    }
+
+    // (c0, k0, ..., c_slot, new keys and children, k_slot, ..., c_n)
+    vector<Value> keys;
+    vector<uint64_t> child_ids;
+    keys.reserve(n + m);
+    child_ids.reserve(n + m + 1);
+    for (int i = 0; i < slot; ++i)
+    {
+        child_ids.push_back(children[i]);
+        keys.push_back(Value(Key(node.get_key(i))));
+    }
+    child_ids.push_back(children[slot]);
+    for (auto & split : splits)
+    {
+        keys.push_back(split.key);
+        child_ids.push_back(split.page_id);
+    }
+    for (uint32_t i = slot; i < n; ++i)
+    {
+        keys.push_back(Value(Key(node.get_key(i))));
+        child_ids.push_back(children[i + 1]);
+    }
+
+    // as few nodes as hold the children, one key between two nodes moves
+    // up and the others are spread evenly, so each is at least half loaded
+    uint32_t total = n + m;
+    uint32_t num_nodes = (total + load + 1) / (load + 1);
+    uint32_t spread = total - (num_nodes - 1);
+    size_t next_key = 0, next_child = 0;
+    auto fill = [&](InternalNode & dst, uint32_t index)
+    {
+        uint32_t count = spread / num_nodes + (index < spread % num_nodes);
+        dst.get_child(0) = child_ids[next_child++];
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            dst.get_key(j) = Key(keys[next_key++]);
+            dst.get_child(j + 1) = child_ids[next_child++];
+        }
+        dst.num_keys() = count;
+    };
+    fill(node, 0);
+
+    splits.clear();
+    for (uint32_t index = 1; index < num_nodes; ++index)
+    {
+        void * new_page = nullptr;
+        auto new_page_id = pager.allocate_page(new_page);
+        touch(new_page_id);
+        PageGuard new_guard(pager, new_page_id);
+        InternalNode new_node(new_guard.data, true);
+        splits.push_back({keys[next_key++], new_page_id});
+        fill(new_node, index);
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+typename BasicBPlusTree<Key, RowSize>::RemoveStatus BasicBPlusTree<Key, RowSize>::remove(Key key)
+{
+    lock_guard<mutex> writer(writer_mutex);
+    DescentPath path;
+    auto location = find(key, &path);
+    if (!location.is_exist)
+        return RemoveStatus::FAIL_KEY_NOT_FOUND;
+
+    remove_cells(location.page_id, path, location.row_id, 1);
+    log_operation();
+    checkpoint_step();
+    return RemoveStatus::SUCCESS;
+}
+
+template <typename Key, uint32_t RowSize>
+size_t BasicBPlusTree<Key, RowSize>::remove_range(Key range_min, Key max_key)
+{
+    // the keys of the range held by one leaf are removed together,
+    // then the tree is searched again since rebalancing moves keys
+    lock_guard<mutex> writer(writer_mutex);
+    size_t num_removed = 0;
+    DescentPath path;
+    Value min_key(range_min);
+    while (min_key <= max_key)
+    {
+        auto location = find(min_key, &path);
+        uint64_t page_id = location.page_id;
+        uint32_t first = location.row_id, count = 0;
+        Value last_key;
+        {
+            PageGuard guard(pager, page_id);
+            LeafNode leaf(guard.data);
+
+            // every key of the leaf is less than min_key, descend again
+            // to the next leaf so that the path leads to it
+            if (first == leaf.num_cells())
+            {
+                if (leaf.next_leaf() == PAGE_ID_INVALID)
+                    break;
+                PageGuard next_guard(pager, leaf.next_leaf());
+                LeafNode next(next_guard.data);
+                if (next.get_key(0) > max_key)
+                    break;
+                location = find(next.get_key(0), &path);
+                page_id = location.page_id;
+                first = 0;
+            }
+        }
+
+        {
+            PageGuard guard(pager, page_id);
+            LeafNode leaf(guard.data);
+            while (first + count < leaf.num_cells() && leaf.get_key(first + count) <= max_key)
+                count += 1;
+            if (count == 0)
+                break;
+            last_key = Key(leaf.get_key(first + count - 1));
+        }
+
+        remove_cells(page_id, path, first, count);
+        log_operation();
+        checkpoint_step();
+        num_removed += count;
+
+        if (last_key == max_key)
+            break;
+        min_key = Traits::successor(last_key);
+    }
+    return num_removed;
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::remove_cells(uint64_t page_id, DescentPath & path, uint32_t cell_num, uint32_t count)
+{
+    // borrows and merges move the children of the right edge
+    last_leaf = PAGE_ID_INVALID;
+    {
+        PageGuard guard(pager, page_id);
+        touch(page_id);
+        LeafNode(guard.data).remove_cells(cell_num, count);
+    }
+
+    // separators stay valid: the max key of a subtree only gets smaller
+    rebalance(page_id, path);
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::rebalance(uint64_t page_id, DescentPath & path)
+{
+    while (true)
+    {
+        PageGuard guard(pager, page_id);
+        auto node = load_node(guard.data);
+
+        // a root is never underloaded, an inner root without keys is
+        // replaced by its only child
+        if (node->is_root())
+        {
+            if (node->node_type() == NODE_TYPE_INNER && node->get_num_keys() == 0)
+            {
+                update_root(((InternalNode *)node.get())->get_child(0));
+                release_page(page_id);
+            }
+            return;
+        }
+
+        uint32_t min_keys = node->node_type() == NODE_TYPE_LEAF ? min_leaf_cells(*(LeafNode *)node.get())
+                                                                : min_inner_keys(*(InternalNode *)node.get());
+        if (node->get_num_keys() >= min_keys)
+            return;
+
+        assert(!path.empty());
+        auto parent_id = path.back().page_id;
+        int index = path.back().slot;
+        path.pop_back();
+        PageGuard parent_guard(pager, parent_id);
+        InternalNode parent(parent_guard.data);
+        assert(parent.get_child(index) == page_id);
+
+        bool merged = node->node_type() == NODE_TYPE_LEAF
+            ? rebalance_leaf(parent, parent_id, index, *(LeafNode *)node.get(), page_id)
+            : rebalance_inner(parent, parent_id, index, *(InternalNode *)node.get(), page_id);
+        if (!merged)
+            return;
+
+        page_id = parent_id;
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+uint32_t BasicBPlusTree<Key, RowSize>::min_leaf_cells(const LeafNode & leaf) const
+{
+    return min(leaf.num_max_cell, leaf_load) / 2;
+}
+
+template <typename Key, uint32_t RowSize>
+uint32_t BasicBPlusTree<Key, RowSize>::min_inner_keys(const InternalNode & node) const
+{
+    return min(node.num_max_keys, inner_node_load) / 2;
+}
+
+template <typename Key, uint32_t RowSize>
+bool BasicBPlusTree<Key, RowSize>::rebalance_leaf(InternalNode & parent, uint64_t parent_id, int index, LeafNode & leaf, uint64_t page_id)
+{
+    // a range removal may take many cells at once, borrow all that are missing
+    uint32_t min_cells = min_leaf_cells(leaf);
+    uint32_t missing = min_cells - leaf.num_cells();
+    touch(parent_id);
+    touch(page_id);
+
+    // borrow the last cells of the left sibling
+    if (index > 0)
+    {
+        auto left_id = parent.get_child(index - 1);
+        PageGuard left_guard(pager, left_id);
+        LeafNode left(left_guard.data);
+        if (left.num_cells() >= min_cells + missing)
+        {
+            touch(left_id);
+            left.shift_to_right(leaf, missing);
+            parent.get_key(index - 1) = Traits::separator(left.get_key(left.num_cells() - 1), leaf.get_key(0));
+            return false;
+        }
+    }
+
+    // borrow the first cells of the right sibling
+    if (index < (int)parent.num_keys())
+    {
+        auto right_id = parent.get_child(index + 1);
+        PageGuard right_guard(pager, right_id);
+        LeafNode right(right_guard.data);
+        if (right.num_cells() >= min_cells + missing)
+        {
+            touch(right_id);
+            right.shift_to_left(leaf, missing);
+            parent.get_key(index) = Traits::separator(leaf.get_key(leaf.num_cells() - 1), right.get_key(0));
+            return false;
+        }
+    }
+
+    // merge the right one of the two leaves into the left one
+    uint64_t left_id = index > 0 ? parent.get_child(index - 1) : page_id;
+    uint64_t right_id = index > 0 ? page_id : parent.get_child(index + 1);
+    {
+        PageGuard left_guard(pager, left_id);
+        PageGuard right_guard(pager, right_id);
+        LeafNode left(left_guard.data);
+        LeafNode right(right_guard.data);
+        touch(left_id);
+        touch(right_id);
+        right.shift_to_left(left, right.num_cells());
+        left.next_leaf() = right.next_leaf();
+
+        if (left.next_leaf() != PAGE_ID_INVALID)
+        {
+            PageGuard next_guard(pager, left.next_leaf());
+            touch(left.next_leaf());
+            LeafNode(next_guard.data).prev_leaf() = left_id;
+        }
+    }
+
+    parent.remove_key_and_right_child(index > 0 ? index - 1 : index);
+    release_page(right_id);
+    return true;
+}
+
+template <typename Key, uint32_t RowSize>
+bool BasicBPlusTree<Key, RowSize>::rebalance_inner(InternalNode & parent, uint64_t parent_id, int index, InternalNode & node, uint64_t page_id)
+{
+    uint32_t min_keys = min_inner_keys(node);
+    touch(parent_id);
+    touch(page_id);
+
+    // rotate the last child of the left sibling through the parent
+    if (index > 0)
+    {
+        auto left_id = parent.get_child(index - 1);
+        PageGuard left_guard(pager, left_id);
+        InternalNode left(left_guard.data);
+        if (left.num_keys() > min_keys)
+        {
+            touch(left_id);
+            uint32_t n = left.num_keys();
+            uint64_t child = left.get_child(n);
+            node.prepend(child, parent.get_key(index - 1));
+            parent.get_key(index - 1) = left.get_key(n - 1);
+            left.num_keys() -= 1;
+            return false;
+        }
+    }
+
+    // rotate the first child of the right sibling through the parent
+    if (index < (int)parent.num_keys())
+    {
+        auto right_id = parent.get_child(index + 1);
+        PageGuard right_guard(pager, right_id);
+        InternalNode right(right_guard.data);
+        if (right.num_keys() > min_keys)
+        {
+            touch(right_id);
+            uint64_t child = right.get_child(0);
+            node.append(parent.get_key(index), child);
+            parent.get_key(index) = right.get_key(0);
+            right.remove_first();
+            return false;
+        }
+    }
+
+    // merge the right node into the left one, the separator moves down
+    int key_id = index > 0 ? index - 1 : index;
+    uint64_t left_id = parent.get_child(key_id);
+    uint64_t right_id = parent.get_child(key_id + 1);
+    {
+        PageGuard left_guard(pager, left_id);
+        PageGuard right_guard(pager, right_id);
+        InternalNode left(left_guard.data);
+        InternalNode right(right_guard.data);
+        touch(left_id);
+        left.append(parent.get_key(key_id), right.get_child(0));
+        for (uint32_t i = 0; i < right.num_keys(); ++i)
+            left.append(right.get_key(i), right.get_child(i + 1));
+    }
+
+    parent.remove_key_and_right_child(key_id);
+    release_page(right_id);
+    return true;
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::release_page(uint64_t page_id)
+{
+    // the page is pinned until the operation is logged as a free page
+    touch(page_id);
+    pager.free_page(page_id);
+    if (wal != nullptr)
+        freed_pages.push_back(page_id);
+}
+
+// number of items of a node built with fill_factor of capacity, at least half
+static uint32_t items_per_node(uint32_t capacity, double fill_factor)
+{
+    uint32_t min_items = (capacity + 1) / 2;
+    uint32_t items = (uint32_t)(capacity * fill_factor + 0.5);
+    return std::max(min_items, std::min(capacity, items));
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::bulk_load(const RowSource & source, double fill_factor)
+{
+    lock_guard<mutex> writer(writer_mutex);
+    if (root->node_type() != NODE_TYPE_LEAF || root->get_num_keys() != 0)
+        throw std::runtime_error("bulk load requires an empty tree");
+    if (!(fill_factor > 0 && fill_factor <= 1))
+        throw std::runtime_error("fill factor shall be in (0, 1]");
+
+    // the capacity of a node does not depend on its content
+    uint32_t leaf_capacity = min(LeafNode(root_page).num_max_cell, leaf_load);
+    uint32_t inner_capacity = min(InternalNode(root_page).num_max_keys, inner_node_load);
+    uint32_t cells_per_leaf = items_per_node(leaf_capacity, fill_factor);
+    uint32_t keys_per_inner = items_per_node(inner_capacity, fill_factor);
+
+    // leaves are appended to the file in key order
+    vector<LevelEntry> level;
+    unique_ptr<PageGuard> leaf_guard;
+    Key key;
+    Row * row;
+    while (source(key, row))
+    {
+        if (!level.empty() && key <= level.back().max_key)
+            throw std::runtime_error("keys of a bulk load shall be strictly increasing");
+        Traits::check(key);
+
+        if (leaf_guard == nullptr || LeafNode(leaf_guard->data).num_cells() == cells_per_leaf)
+        {
+            void * page = nullptr;
+            auto page_id = pager.allocate_page(page);
+            LeafNode new_leaf(page, row_size);
+            leaf_guard = make_unique<PageGuard>(pager, page_id);
+
+            if (!level.empty())
+            {
+                auto prev_id = level.back().page_id;
+                LeafNode(leaf_guard->data).prev_leaf() = prev_id;
+                LeafNode(pager.get_page(prev_id)).next_leaf() = page_id;
+                pager.mark_dirty(prev_id);
+            }
+            level.push_back({page_id, Value(key), Value(key)});
+        }
+
+        LeafNode leaf(leaf_guard->data);
+        void * cell = leaf.allocate_cell(key);
+        row->serialize(LeafNode::extract_value(cell));
+        pager.mark_dirty(level.back().page_id);
+        level.back().max_key = key;
+    }
+    leaf_guard.reset();
+
+    if (level.empty())
+        return;
+
+    balance_last_leaves(level, (leaf_capacity + 1) / 2);
+    while (level.size() > 1)
+        level = build_inner_level(level, keys_per_inner, (inner_capacity + 1) / 2);
+
+    // the new pages reach disk before the root is switched, a crash
+    // during the load leaves the empty tree
+    pager.sync_to_disk();
+
+    auto old_root = get_root_page();
+    update_root(level[0].page_id);
+    log_operation();
+
+    // readers may still be on the old root
+    latch(old_root);
+    pager.free_page(old_root);
+    release_latches();
+
+    if (wal != nullptr)
+        checkpoint();
+    else
+        pager.sync_to_disk();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::balance_last_leaves(vector<LevelEntry> & leaves, uint32_t min_cells)
+{
+    if (leaves.size() < 2)
+        return;
+
+    auto last_id = leaves.back().page_id;
+    auto prev_id = leaves[leaves.size() - 2].page_id;
+    PageGuard last_guard(pager, last_id);
+    PageGuard prev_guard(pager, prev_id);
+    LeafNode last(last_guard.data);
+    LeafNode prev(prev_guard.data);
+    if (last.num_cells() >= min_cells)
+        return;
+
+    uint32_t total = last.num_cells() + prev.num_cells();
+    if (total >= 2 * min_cells)
+    {
+        prev.shift_to_right(last, total / 2 - last.num_cells());
+        leaves[leaves.size() - 2].max_key = Key(prev.get_key(prev.num_cells() - 1));
+        leaves.back().min_key = Key(last.get_key(0));
+        pager.mark_dirty(prev_id);
+        pager.mark_dirty(last_id);
+        return;
+    }
+
+    // both fit into one leaf
+    last.shift_to_left(prev, last.num_cells());
+    prev.next_leaf() = PAGE_ID_INVALID;
+    leaves[leaves.size() - 2].max_key = leaves.back().max_key;
+    leaves.pop_back();
+    pager.mark_dirty(prev_id);
+    pager.free_page(last_id);
+}
+
+template <typename Key, uint32_t RowSize>
+auto BasicBPlusTree<Key, RowSize>::build_inner_level(const vector<LevelEntry> & children, uint32_t num_keys, uint32_t min_keys) -> vector<LevelEntry>
+{
+    // split children into nodes of num_keys + 1, the last two nodes
+    // share their children when the last one would be less than half loaded
+    vector<size_t> sizes;
+    size_t per_node = num_keys + 1, min_children = min_keys + 1;
+    size_t remain = children.size();
+    while (remain > per_node)
+    {
+        sizes.push_back(per_node);
+        remain -= per_node;
+    }
+    sizes.push_back(remain);
+    if (sizes.size() > 1 && remain < min_children)
+    {
+        size_t total = per_node + remain;
+        sizes.pop_back();
+        sizes.pop_back();
+        if (total >= 2 * min_children)
+        {
+            sizes.push_back(total - total / 2);
+            sizes.push_back(total / 2);
+        }
+        else
+        {
+            sizes.push_back(total);
+        }
+    }
+
+    vector<LevelEntry> level;
+    size_t begin = 0;
+    for (auto size : sizes)
+    {
+        void * page = nullptr;
+        auto page_id = pager.allocate_page(page);
+        PageGuard guard(pager, page_id);
+        InternalNode node(guard.data, true);
 
-    // special case: root is empty
-    if (curr->get_num_keys() == 0)
-        return KeyLocation(page_id, 0, false);
+        // separator i lies between the max key of child i and the min key of child i + 1
+        for (size_t i = begin + 1; i < begin + size; ++i)
+            node.insert(Traits::separator(children[i - 1].max_key, children[i].min_key), children[i - 1].page_id, children[i].page_id);
 
-    // search correct page id on leaf
-    while (curr->node_type() != NODE_TYPE_LEAF)
+        pager.mark_dirty(page_id);
+        level.push_back({page_id, children[begin].min_key, children[begin + size - 1].max_key});
+        begin += size;
+    }
+    return level;
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::commit()
+{
+    lock_guard<mutex> writer(writer_mutex);
+    // without a log every page and the meta data have to reach disk
+    if (wal != nullptr)
+        wal->commit();
+    else
+        pager.sync_to_disk();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::touch(uint64_t page_id)
+{
+    latch(page_id);
+    pager.mark_dirty(page_id, operation_lsn());
+    if (wal == nullptr)
+        return;
+
+    // a touched page shall not be written before its group is appended
+    if (std::find(touched_pages.begin(), touched_pages.end(), page_id) == touched_pages.end())
+    {
+        pager.pin_page(page_id);
+        touched_pages.push_back(page_id);
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::latch(uint64_t page_id)
+{
+    if (std::find(latched_pages.begin(), latched_pages.end(), page_id) == latched_pages.end())
+    {
+        latches.write_lock(page_id);
+        latched_pages.push_back(page_id);
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::release_latches()
+{
+    for (auto page_id : latched_pages)
+        latches.write_unlock(page_id);
+    latched_pages.clear();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::log_operation(const void * inserted_cell)
+{
+    if (wal == nullptr)
+    {
+        release_latches();
+        return;
+    }
+
+    WalGroup group;
+    uint64_t lsn = wal->next_lsn();
+    group.num_pages = pager.num_pages();
+    group.free_head = pager.free_list_head();
+    group.num_free = pager.num_free_pages();
+
+    for (auto page_id : touched_pages)
+    {
+        // the page holds the link of the free list only
+        void * page = pager.get_page(page_id);
+        if (std::find(freed_pages.begin(), freed_pages.end(), page_id) != freed_pages.end())
+        {
+            Node::set_page_lsn_of(page, lsn);
+            group.records.push_back({WalRecordType::FREE_PAGE, page_id, string((const char *)page, sizeof(uint64_t))});
+            continue;
+        }
+
+        auto node = load_node(page);
+        node->page_lsn() = lsn;
+
+        // the cell is enough to redo an insert into a leaf which did not split
+        if (inserted_cell != nullptr)
+        {
+            auto leaf = (LeafNode *)node.get();
+            group.records.push_back({WalRecordType::LEAF_INSERT, page_id, string((const char *)inserted_cell, leaf->cell_size)});
+        }
+        else
+        {
+            group.records.push_back({WalRecordType::PAGE_IMAGE, page_id, string((const char *)node->data, node->used_bytes())});
+        }
+    }
+
+    if (root_changed)
+        group.records.push_back({WalRecordType::SET_ROOT, pager.get_root_page(), ""});
+
+    wal->append(group);
+    if (root_changed)
+        meta_lsn = lsn;
+
+    for (auto page_id : touched_pages)
+        pager.unpin_page(page_id);
+    touched_pages.clear();
+    freed_pages.clear();
+    root_changed = false;
+
+    // the page lsn was the last change of the nodes
+    release_latches();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::recover()
+{
+    wal->replay(
+        [this](const WalGroup & group)
+        {
+            // meta data on disk is as old as the last checkpoint
+            pager.extend_to(group.num_pages);
+            pager.restore_free_list(group.free_head, group.num_free);
+            for (auto & record : group.records)
+            {
+                if (record.type == WalRecordType::SET_ROOT)
+                {
+                    pager.set_root_page(record.page_id);
+                    continue;
+                }
+
+                PageGuard guard(pager, record.page_id);
+
+                // the page on disk already contains the change
+                if (Node::get_page_lsn_from(guard.data) >= group.lsn)
+                    continue;
+
+                if (record.type == WalRecordType::LEAF_INSERT)
+                {
+                    LeafNode leaf(guard.data);
+                    leaf.insert_cell(record.payload.data());
+                }
+                else
+                {
+                    memcpy(guard.data, record.payload.data(), record.payload.size());
+                }
+
+                Node::set_page_lsn_of(guard.data, group.lsn);
+                pager.mark_dirty(record.page_id, group.lsn);
+            }
+        });
+
+    checkpoint();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::checkpoint()
+{
+    wal->commit();
+    pager.sync_to_disk();
+    wal->reset();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::checkpoint_step()
+{
+    pager.checkpoint_step(wal == nullptr ? UINT64_MAX : wal->durable_lsn());
+    if (wal == nullptr || !wal->needs_checkpoint())
+        return;
+
+    // fuzzy checkpoint: pages written so far are synced together with the
+    // meta data, then the log keeps the groups of pages still dirty
+    uint64_t first_lsn = min(pager.oldest_dirty_lsn(), wal->next_lsn());
+    if (first_lsn <= wal->first_lsn())
+        return;
+
+    wal->commit();
+    pager.sync_metadata();
+    wal->truncate(first_lsn);
+}
+
+template <typename Key, uint32_t RowSize>
+bool BasicBPlusTree<Key, RowSize>::descend_optimistic(Key key, ReadNode & node)
+{
+    // the root may be replaced between reading its id and its version
+    node.page_id = root_id.load(std::memory_order_acquire);
+    node.version = latches.read_lock(node.page_id);
+    if (root_id.load(std::memory_order_acquire) != node.page_id)
+        return false;
+
+    while (true)
+    {
+        node.page = reader_page(node.page_id);
+        if (node.page == nullptr)
+            return false;
+        if (Node::get_node_type_from(node.page) != NODE_TYPE_INNER)
+            return true;
+
+        // a count read from a node under change is cut to the capacity, so
+        // that the search stays within the page
+        BasicInnerView<Key> inner(node.page);
+        uint32_t n = min(inner.num_keys(), InternalNode::Layout::INTERNAL_MAX_KEYS);
+        uint64_t child = inner.child(Traits::lower_bound(inner.keys(), n, key));
+
+        // the version of the child is read before the node is validated,
+        // so it is the version of a child of the node
+        uint64_t child_version = latches.read_lock(child);
+        if (!latches.validate(node.page_id, node.version))
+            return false;
+        node.page_id = child;
+        node.version = child_version;
+    }
+}
+
+// cells of a leaf for an optimistic reader, counts and slots read from a
+// leaf under change are cut so that the cell stays within the page
+template <typename Key, uint32_t RowSize>
+static inline uint32_t reader_num_cells(const void * page, const LeafCellLayout<Key, RowSize> & cells)
+{
+    return min(BasicLeafView<Key>(page).num_cells(), cells.capacity);
+}
+
+template <typename Key, uint32_t RowSize>
+static inline const char * reader_cell(const void * page, uint32_t cell_num, const LeafCellLayout<Key, RowSize> & cells)
+{
+    uint16_t slot = ((const uint16_t *)((const char *)page + cells.slots_offset))[cell_num];
+    return (const char *)page + cells.heap_offset + (size_t)min<uint32_t>(slot, cells.capacity - 1) * cells.cell_size;
+}
+
+template <typename Key, uint32_t RowSize>
+KeyLocation BasicBPlusTree<Key, RowSize>::find(Key key)
+{
+    // no thread changes a tree of a buffer pool beside the reader
+    if (!pager.shared_reads())
+        return find(key, nullptr);
+
+    ReadNode node;
+    while (true)
+    {
+        if (!descend_optimistic(key, node))
+            continue;
+
+        BasicLeafView<Key> leaf(node.page);
+        uint32_t n = reader_num_cells(node.page, leaf_cells);
+        uint32_t pos = Traits::lower_bound(leaf.keys(), n, key);
+        bool is_exist = pos < n && leaf.key(pos) == key;
+        if (latches.validate(node.page_id, node.version))
+            return KeyLocation(node.page_id, pos, is_exist);
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+bool BasicBPlusTree<Key, RowSize>::find_row(Key key, void * row)
+{
+    ReadNode node;
+    while (true)
+    {
+        if (!descend_optimistic(key, node))
+            continue;
+
+        // the row is copied before the leaf is validated, a restart copies it again
+        BasicLeafView<Key> leaf(node.page);
+        uint32_t n = reader_num_cells(node.page, leaf_cells);
+        uint32_t pos = Traits::lower_bound(leaf.keys(), n, key);
+        bool is_exist = pos < n && leaf.key(pos) == key;
+        if (is_exist)
+            memcpy(row, reader_cell(node.page, pos, leaf_cells) + NodeLayout<Key>::LEAF_VALUE_OFFSET, row_size);
+        if (latches.validate(node.page_id, node.version))
+            return is_exist;
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+template <typename CellVisitor>
+size_t BasicBPlusTree<Key, RowSize>::scan_cells(Key min_key, Key max_key, CellVisitor && visit)
+{
+    using Stored = typename Traits::Stored;
+
+    // the cells of the range in a leaf are copied and visited once the leaf
+    // is validated. the next leaf is taken with the leaf still valid, a
+    // restart descends to the first key which is not visited yet
+    vector<char> copies;
+    Value from(min_key);
+    size_t num_visited = 0;
+    ReadNode node;
+    bool descend = true;
+    while (true)
+    {
+        if (descend && !descend_optimistic(from, node))
+            continue;
+        descend = false;
+
+        BasicLeafView<Key> leaf(node.page);
+        uint32_t n = reader_num_cells(node.page, leaf_cells);
+        uint32_t first = Traits::lower_bound(leaf.keys(), n, from), end = first;
+        while (end < n && leaf.key(end) <= max_key)
+            end += 1;
+
+        copies.resize((size_t)(end - first) * leaf_cells.cell_size);
+        for (uint32_t i = first; i < end; ++i)
+            memcpy(copies.data() + (size_t)(i - first) * leaf_cells.cell_size, reader_cell(node.page, i, leaf_cells), leaf_cells.cell_size);
+
+        uint64_t next = leaf.next_leaf();
+        bool range_ends = end < n || next == PAGE_ID_INVALID;
+        uint64_t next_version = range_ends ? 0 : latches.read_lock(next);
+        if (!latches.validate(node.page_id, node.version))
+        {
+            descend = true;
+            continue;
+        }
+
+        for (uint32_t i = 0; i < end - first; ++i)
+        {
+            num_visited += 1;
+            if (!visit(copies.data() + (size_t)i * leaf_cells.cell_size))
+                return num_visited;
+        }
+
+        // the successor of the largest key would wrap around
+        Stored stored;
+        if (end > first)
+            memcpy(&stored, copies.data() + (size_t)(end - first - 1) * leaf_cells.cell_size, sizeof(Stored));
+        if (range_ends || (end > first && Key(stored) == max_key))
+            return num_visited;
+        if (end > first)
+            from = Traits::successor(Key(stored));
+
+        node.page_id = next;
+        node.version = next_version;
+        node.page = reader_page(next);
+        descend = node.page == nullptr;
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+size_t BasicBPlusTree<Key, RowSize>::scan(Key min_key, Key max_key, const RowVisitor & visit)
+{
+    typename Traits::Stored stored;
+    return scan_cells(min_key, max_key, [&](const char * cell) {
+        memcpy(&stored, cell, sizeof(stored));
+        return visit(Key(stored), cell + NodeLayout<Key>::LEAF_VALUE_OFFSET);
+    });
+}
+
+template <typename Key, uint32_t RowSize>
+std::vector<typename BasicBPlusTree<Key, RowSize>::Value> BasicBPlusTree<Key, RowSize>::morsel_bounds(
+    Key min_key, Key max_key, size_t num_morsels)
+{
+    // a node which changes under the reader is read again. keys of a node
+    // which was split or freed meanwhile still cut the range, only the
+    // morsels are less even
+    vector<Value> bounds, level_bounds;
+    vector<uint64_t> level{root_id.load(std::memory_order_acquire)}, children;
+    while (bounds.size() + 1 < num_morsels && !level.empty())
+    {
+        level_bounds.clear();
+        children.clear();
+        for (auto page_id : level)
+        {
+            while (true)
+            {
+                uint64_t version = latches.read_lock(page_id);
+                const void * page = reader_page(page_id);
+                if (page == nullptr || Node::get_node_type_from(page) != NODE_TYPE_INNER)
+                    break;
+
+                // the keys inside the range and the children between them
+                BasicInnerView<Key> inner(page);
+                size_t num_bounds = level_bounds.size(), num_children = children.size();
+                uint32_t n = min(inner.num_keys(), InternalNode::Layout::INTERNAL_MAX_KEYS);
+                uint32_t i = Traits::lower_bound(inner.keys(), n, min_key), j = i;
+                while (j < n && inner.key(j) < max_key)
+                    level_bounds.push_back(Value(inner.key(j++)));
+                for (uint32_t k = i; k <= j; ++k)
+                    children.push_back(inner.child(k));
+
+                if (latches.validate(page_id, version))
+                    break;
+                level_bounds.resize(num_bounds);
+                children.resize(num_children);
+            }
+        }
+
+        bounds.insert(bounds.end(), level_bounds.begin(), level_bounds.end());
+        sort(bounds.begin(), bounds.end());
+        bounds.erase(unique(bounds.begin(), bounds.end()), bounds.end());
+        level.swap(children);
+    }
+
+    // a level below a narrow one may cut much finer than asked, every
+    // step-th key is kept then
+    if (bounds.size() >= 2 * num_morsels)
     {
-        // keys[pos] <= key < keys[pos+1]
-        auto pos = curr->search_key_position(key);
+        size_t step = bounds.size() / num_morsels, kept = 0;
+        for (size_t i = step - 1; i < bounds.size(); i += step)
+            bounds[kept++] = bounds[i];
+        bounds.resize(kept);
+    }
+    return bounds;
+}
+
+// morsels a thread of a parallel scan gets on average, more morsels even
+// out skewed ones by stealing at the cost of a descent each
+static const size_t PARALLEL_SCAN_MORSELS_PER_THREAD = 8;
+
+template <typename Key, uint32_t RowSize>
+size_t BasicBPlusTree<Key, RowSize>::parallel_scan(
+    Key min_key, Key max_key, WorkStealingPool & pool, bool ordered, const ParallelRowVisitor & visit)
+{
+    using Stored = typename Traits::Stored;
+    auto visit_cell = [&](unsigned worker, const char * cell) {
+        Stored stored;
+        memcpy(&stored, cell, sizeof(Stored));
+        return visit(worker, Key(stored), cell + NodeLayout<Key>::LEAF_VALUE_OFFSET);
+    };
+
+    // threads share pages only through a mapping
+    if (min_key > max_key)
+        return 0;
+    if (!pager.shared_reads() || pool.num_threads() == 1)
+        return scan_cells(min_key, max_key, [&](const char * cell) { return visit_cell(0, cell); });
+
+    // morsel i ends at bounds[i], the next one starts at its successor
+    vector<Value> bounds = morsel_bounds(min_key, max_key, (size_t)pool.num_threads() * PARALLEL_SCAN_MORSELS_PER_THREAD);
+    size_t num_morsels = bounds.size() + 1;
+    auto morsel_min = [&](size_t i) { return i == 0 ? Value(min_key) : Traits::successor(bounds[i - 1]); };
+    auto morsel_max = [&](size_t i) { return i == bounds.size() ? max_key : Key(bounds[i]); };
+
+    std::atomic<size_t> num_visited(0);
+    std::atomic<bool> stopped(false);
+    if (!ordered)
+    {
+        pool.run(num_morsels, [&](unsigned worker, size_t i) {
+            size_t n = 0;
+            Value from = morsel_min(i);
+            scan_cells(from, morsel_max(i), [&](const char * cell) {
+                if (stopped.load(std::memory_order_relaxed))
+                    return false;
+                n += 1;
+                if (!visit_cell(worker, cell))
+                    stopped.store(true, std::memory_order_relaxed);
+                return !stopped.load(std::memory_order_relaxed);
+            });
+            num_visited += n;
+        });
+        return num_visited;
+    }
+
+    // the cells of a morsel are copied, the morsels which are done are
+    // visited in order by one thread at a time while the others go on
+    struct Morsel
+    {
+        vector<char> cells;
+        bool done = false;
+    };
+    vector<Morsel> morsels(num_morsels);
+    std::mutex visit_mutex;
+    size_t next_visit = 0;
+    bool visiting = false;
+    pool.run(num_morsels, [&](unsigned worker, size_t i) {
+        auto & cells = morsels[i].cells;
+        Value from = morsel_min(i);
+        if (!stopped.load(std::memory_order_relaxed))
+            scan_cells(from, morsel_max(i), [&](const char * cell) {
+                cells.insert(cells.end(), cell, cell + leaf_cells.cell_size);
+                return !stopped.load(std::memory_order_relaxed);
+            });
+
+        std::unique_lock<std::mutex> lock(visit_mutex);
+        morsels[i].done = true;
+        if (visiting)
+            return;
+
+        visiting = true;
+        while (next_visit < num_morsels && morsels[next_visit].done)
+        {
+            vector<char> ready;
+            ready.swap(morsels[next_visit++].cells);
+            lock.unlock();
+            for (size_t c = 0; c < ready.size() && !stopped.load(std::memory_order_relaxed); c += leaf_cells.cell_size)
+            {
+                num_visited += 1;
+                if (!visit_cell(worker, ready.data() + c))
+                    stopped.store(true, std::memory_order_relaxed);
+            }
+            lock.lock();
+        }
+        visiting = false;
+    });
+    return num_visited;
+}
+
+template <typename Key, uint32_t RowSize>
+KeyLocation BasicBPlusTree<Key, RowSize>::find(Key key, DescentPath * path)
+{
+    if (path != nullptr)
+        path->clear();
+
+    // search correct page id on leaf, the root page is pinned
+    uint64_t page_id = pager.get_root_page();
+    const void * page = root_page;
+    while (Node::get_node_type_from(page) == NODE_TYPE_INNER)
+    {
+        BasicInnerView<Key> inner(page);
+        uint32_t slot = inner.child_slot(key);
+        if (path != nullptr)
+            path->push_back({page_id, (int)slot});
+
+        page_id = inner.child(slot);
+        page = pager.get_page(page_id);
+    }
+
+    // now current node is leaf, an empty root leaf has no cell
+    BasicLeafView<Key> leaf(page);
+    uint32_t pos = leaf.lower_bound(key);
+    return KeyLocation(page_id, pos, pos < leaf.num_cells() && leaf.key(pos) == key);
+}
 
-        // when key == keys[pos] ->  search slot[pos]
-        // when keys[pos] < key  -> search slot[pos+1]
-        int slot = (pos >= 0 && curr->get_key(pos) == key) ? pos : pos + 1;
+// nodes of a level which are pinned and prefetched ahead of the node searched
+static const size_t MULTI_FIND_PREFETCH_DISTANCE = 8;
+// bytes of a node prefetched: the header and the keys the search reads first
+static const uint32_t MULTI_FIND_PREFETCH_BYTES = 256;
 
-        // search next page
-        page_id = ((InternalNode *)curr.get())->get_child(slot);
-        curr = BtreeNode::LoadNodeFrom(pager.get_page(page_id));
+static inline void prefetch_node(const void * page)
+{
+    for (uint32_t offset = 0; offset < MULTI_FIND_PREFETCH_BYTES; offset += 64)
+        __builtin_prefetch((const char *)page + offset);
+}
+
+template <typename Key, uint32_t RowSize>
+std::vector<KeyLocation> BasicBPlusTree<Key, RowSize>::multi_find(const std::vector<Key> & keys)
+{
+    vector<KeyLocation> locations(keys.size(), KeyLocation(PAGE_ID_INVALID, 0, false));
+    if (keys.empty())
+        return locations;
+
+    vector<uint32_t> order(keys.size());
+    for (uint32_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+    auto key_at = [&](uint32_t i) -> const Key & { return keys[order[i]]; };
+
+    // the leaves reached add no range to the next level
+    vector<ProbeRange> level = {{pager.get_root_page(), 0, (uint32_t)keys.size()}}, next;
+    vector<void *> pages;
+
+    // a node is pinned when it is prefetched, one more than the distance
+    // of nodes are pinned at once. half the pool is left for the root and
+    // for the pages other parts of the tree keep pinned
+    size_t distance = min(MULTI_FIND_PREFETCH_DISTANCE, pager.pool_capacity() / 2);
+    while (!level.empty())
+    {
+        pages.assign(level.size(), nullptr);
+        auto fetch = [&](size_t i)
+        {
+            if (i < level.size())
+            {
+                pages[i] = pager.pin_page(level[i].page_id);
+                prefetch_node(pages[i]);
+            }
+        };
+        for (size_t i = 0; i < distance; ++i)
+            fetch(i);
+
+        next.clear();
+        for (size_t i = 0; i < level.size(); ++i)
+        {
+            fetch(i + distance);
+            auto & range = level[i];
+            if (Node::get_node_type_from(pages[i]) == NODE_TYPE_LEAF)
+            {
+                BasicLeafView<Key> leaf(pages[i]);
+                for (uint32_t k = range.begin; k < range.end; ++k)
+                {
+                    uint32_t pos = leaf.lower_bound(key_at(k));
+                    locations[order[k]] = KeyLocation(range.page_id, pos, pos < leaf.num_cells() && leaf.key(pos) == key_at(k));
+                }
+            }
+            else
+            {
+                // the keys up to key slot go to child slot with one search
+                BasicInnerView<Key> inner(pages[i]);
+                uint32_t n = inner.num_keys();
+                for (uint32_t k = range.begin; k < range.end;)
+                {
+                    uint32_t slot = inner.child_slot(key_at(k));
+                    uint32_t last = k + 1;
+                    if (slot == n)
+                        last = range.end;
+                    else
+                        while (last < range.end && key_at(last) <= inner.key(slot))
+                            last += 1;
+                    next.push_back({inner.child(slot), k, last});
+                    k = last;
+                }
+            }
+            pager.unpin_page(range.page_id);
+        }
+        swap(level, next);
     }
+    return locations;
+}
 
-    // now current node is leaf
-    assert(curr->node_type() == NODE_TYPE_LEAF);
-    auto pos = curr->search_key_position(key);
+template <typename Key, uint32_t RowSize>
+auto BasicBPlusTree<Key, RowSize>::seek(Key min_key) -> LeafCursor
+{
+    auto location = find(min_key);
+    return LeafCursor(pager, location.page_id, location.row_id);
+}
 
-    // find the key
-    if (pos >= 0 && curr->get_key(pos) == key)
-        return KeyLocation(page_id, pos, true);
-    // key not found
+template <typename Key, uint32_t RowSize>
+auto BasicBPlusTree<Key, RowSize>::seek_reverse(Key max_key) -> LeafCursor
+{
+    // row_id of a missing key is where it would be inserted
+    auto location = find(max_key);
+    return LeafCursor(pager, location.page_id, location.is_exist ? location.row_id : location.row_id - 1);
+}
+
+template <typename Key, uint32_t RowSize>
+BasicLeafCursor<Key, RowSize>::BasicLeafCursor(BTreePager & pager, uint64_t page_id, int cell_id)
+    : pager(&pager), page_id(PAGE_ID_INVALID), page(nullptr), cell_id(cell_id)
+{
+    move_to(page_id);
+    if (cell_id < 0)
+        settle_backward();
     else
-        return KeyLocation(page_id, pos + 1, false);
+        settle_forward();
+}
+
+template <typename Key, uint32_t RowSize>
+BasicLeafCursor<Key, RowSize>::~BasicLeafCursor()
+{
+    move_to(PAGE_ID_INVALID);
+}
+
+template <typename Key, uint32_t RowSize>
+BasicLeafCursor<Key, RowSize>::BasicLeafCursor(BasicLeafCursor && other) : pager(other.pager), page_id(other.page_id), page(other.page), cell_id(other.cell_id)
+{
+    // the pin moves with the cursor
+    other.page_id = PAGE_ID_INVALID;
+    other.page = nullptr;
+}
+
+template <typename Key, uint32_t RowSize>
+Key BasicLeafCursor<Key, RowSize>::key() const
+{
+    assert(is_valid());
+    return BasicLeafView<Key>(page).key(cell_id);
+}
+
+template <typename Key, uint32_t RowSize>
+void * BasicLeafCursor<Key, RowSize>::cell() const
+{
+    assert(is_valid());
+    return BasicLeafNode<Key, RowSize>(page).get_cell(cell_id);
+}
+
+template <typename Key, uint32_t RowSize>
+void * BasicLeafCursor<Key, RowSize>::value() const
+{
+    return BasicLeafNode<Key, RowSize>::extract_value(cell());
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicLeafCursor<Key, RowSize>::next()
+{
+    assert(is_valid());
+    cell_id += 1;
+    settle_forward();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicLeafCursor<Key, RowSize>::prev()
+{
+    assert(is_valid());
+    cell_id -= 1;
+    settle_backward();
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicLeafCursor<Key, RowSize>::move_to(uint64_t next_page_id)
+{
+    if (page_id != PAGE_ID_INVALID)
+        pager->unpin_page(page_id);
+
+    page_id = next_page_id;
+    page = page_id == PAGE_ID_INVALID ? nullptr : pager->pin_page(page_id);
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicLeafCursor<Key, RowSize>::settle_forward()
+{
+    while (is_valid() && cell_id >= (int)BasicLeafNode<Key, RowSize>(page).get_num_keys())
+    {
+        move_to(BasicLeafNode<Key, RowSize>(page).next_leaf());
+        cell_id = 0;
+    }
+}
+
+template <typename Key, uint32_t RowSize>
+void BasicLeafCursor<Key, RowSize>::settle_backward()
+{
+    while (is_valid() && cell_id < 0)
+    {
+        move_to(BasicLeafNode<Key, RowSize>(page).prev_leaf());
+        if (is_valid())
+            cell_id = (int)BasicLeafNode<Key, RowSize>(page).get_num_keys() - 1;
+    }
 }
 
 struct QueNodeInfo
 {
     uint64_t page_id;
-    unique_ptr<BtreeNode> node;
     int level;
 
-    QueNodeInfo(uint64_t pid, unique_ptr<BtreeNode> && node_ptr, int level) : page_id(pid), node(std::move(node_ptr)), level(level) { }
+    QueNodeInfo(uint64_t pid, int level) : page_id(pid), level(level) { }
 };
 
-void BPlusTree::print_keys()
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::print_keys()
 {
-    auto node_curr = BtreeNode::LoadNodeFrom(root_page);
-    uint64_t page_id_curr = get_root_page();
+    // queue keeps page ids only, a queued page may be evicted before it is printed
     int level = -1;
     queue<QueNodeInfo> que;
-    que.push({page_id_curr, std::move(node_curr), 0});
+    que.push({get_root_page(), 0});
 
     while (!que.empty())
     {
-        node_curr = std::move(que.front().node);
+        uint64_t page_id_curr = que.front().page_id;
         int level_curr = que.front().level;
-        page_id_curr = que.front().page_id;
         que.pop();
 
         if (level < level_curr)
@@ -271,61 +1679,72 @@ void BPlusTree::print_keys()
             cout << "level " << level << ":" << endl;
         }
 
+        const void * page = pager.get_page(page_id_curr);
         printf("page %3lld: ", page_id_curr);
         // print key of the node
-        for (int i = 0; i < node_curr->get_num_keys(); ++i)
-            printf("%d ", node_curr->get_key(i));
-        cout << endl;
-
-        if (node_curr->node_type() == NODE_TYPE_INNER)
+        if (Node::get_node_type_from(page) == NODE_TYPE_INNER)
         {
-            InternalNode * ptr = (InternalNode *)node_curr.get();
-            for (int i = 0; i <= ptr->get_num_keys(); ++i)
-            {
-                auto page_id_next = ptr->get_child(i);
-                void * page_next = pager.get_page(page_id_next);
-                que.push({page_id_next, BtreeNode::LoadNodeFrom(page_next), level + 1});
-            }
+            BasicInnerView<Key> inner(page);
+            for (uint32_t i = 0; i < inner.num_keys(); ++i)
+                printf("%s ", Traits::to_string(inner.key(i)).c_str());
+            for (uint32_t i = 0; i <= inner.num_keys(); ++i)
+                que.push({inner.child(i), level + 1});
+        }
+        else
+        {
+            BasicLeafView<Key> leaf(page);
+            for (uint32_t i = 0; i < leaf.num_cells(); ++i)
+                printf("%s ", Traits::to_string(leaf.key(i)).c_str());
         }
+        cout << endl;
     }
 }
 
 
-void BPlusTree::post_order_visit(
+template <typename Key, uint32_t RowSize>
+void BasicBPlusTree<Key, RowSize>::post_order_visit(
     uint64_t page_id,
-    std::function<void(uint64_t)> inner_node_action,
-    std::function<void(uint64_t)> leaf_node_action,
-    std::function<void(void *)> leaf_cell_action,
-    uint32_t min_key,
-    uint32_t max_key)
+    const std::function<void(uint64_t)> & inner_node_action,
+    const std::function<void(uint64_t)> & leaf_node_action,
+    const std::function<void(void *)> & leaf_cell_action,
+    std::optional<Key> min_key,
+    std::optional<Key> max_key)
 {
     // when range is empty or node is empty, noting to do and return
-    if (min_key > max_key)
-        return;
-    auto node = get_node_by(page_id);
-    if (node->get_num_keys() == 0)
+    if (min_key && max_key && *min_key > *max_key)
         return;
 
-    int n = node->get_num_keys();
+    // keep the node in memory while its children are visited
+    PageGuard guard(pager, page_id);
 
     // when node is a inner node. visit all its child then itself
-    if (node->node_type() == NODE_TYPE_INNER)
+    if (Node::get_node_type_from(guard.data) == NODE_TYPE_INNER)
     {
+        BasicInnerView<Key> inner(guard.data);
+        int n = inner.num_keys();
+        if (n == 0)
+            return;
+
         int i = 0, j = n - 1;
-        // loop until min_key <= node->get_key(i)
-        while (i < n && node->get_key(i) < min_key)
+        // loop until min_key <= key[i]
+        while (min_key && i < n && inner.key(i) < *min_key)
             i += 1;
 
         // loop until key[j] < max_key
-        while (j >= 0 && node->get_key(j) >= max_key)
+        while (max_key && j >= 0 && inner.key(j) >= *max_key)
             j -= 1;
 
         assert(i <= j + 1);
 
-        // visit child node
-        InternalNode * ptr = dynamic_cast<InternalNode *>(node.get());
+        // visit child node, children in range are requested together
+        // so that their reads overlap
+        std::vector<uint64_t> children;
         for (int k = i; k <= j + 1; ++k)
-            post_order_visit(ptr->get_child(k), inner_node_action, leaf_node_action, leaf_cell_action, min_key, max_key);
+            children.push_back(inner.child(k));
+        pager.prefetch(children);
+
+        for (auto child : children)
+            post_order_visit(child, inner_node_action, leaf_node_action, leaf_cell_action, min_key, max_key);
 
         // visit current node
         if (inner_node_action != nullptr)
@@ -334,16 +1753,19 @@ void BPlusTree::post_order_visit(
     // when current node is leaf, visit all row with key in range
     else
     {
-        // visit row
-        LeafNode * ptr = dynamic_cast<LeafNode *>(node.get());
+        LeafNode leaf(guard.data);
+        uint32_t n = leaf.num_cells();
+        if (n == 0)
+            return;
 
+        // visit row
         if (leaf_cell_action != nullptr)
         {
-            for (int k = 0; k < n; ++k)
+            for (uint32_t k = 0; k < n; ++k)
             {
-                uint32_t key = ptr->get_key(k);
-                if (key >= min_key && key <= max_key)
-                    leaf_cell_action(ptr->get_cell(k));
+                Key key = leaf.get_key(k);
+                if ((!min_key || key >= *min_key) && (!max_key || key <= *max_key))
+                    leaf_cell_action(leaf.get_cell(k));
             }
         }
 
@@ -352,49 +1774,61 @@ void BPlusTree::post_order_visit(
     }
 }
 
-bool BPlusTree::check_valid()
+template <typename Key, uint32_t RowSize>
+bool BasicBPlusTree<Key, RowSize>::check_valid()
 {
     // keys hall increasing in all nodes
     // if current node is root its root bit must be set, its parent is invalid
     // if current node is not root it root bit must unset, its loading shall >= 50%
-    // if current node is internal, its childs's parents shall correctly set
+    //  unless it is the last node of its level: appends split those 90/10
+    // if current node is internal, none of its children is marked as root
     // if current node is internal, its
     // if current node is internal, max(lef_child) <= key < min(right_child)
     // return true;
     bool is_valid = true;
-    std::function<void(uint64_t)> inner_node_checker = [this, &is_valid](uint64_t page_id)
+    std::vector<uint64_t> right_edge;
+    for (uint64_t page_id = pager.get_root_page();;)
+    {
+        right_edge.push_back(page_id);
+        PageGuard guard(pager, page_id);
+        if (Node::get_node_type_from(guard.data) != NODE_TYPE_INNER)
+            break;
+        BasicInnerView<Key> inner(guard.data);
+        page_id = inner.child(inner.num_keys());
+    }
+
+    std::function<void(uint64_t)> inner_node_checker = [this, &is_valid, &right_edge](uint64_t page_id)
     {
         // cout << page_id << endl;
         if (!is_valid) return;
-        auto ptr = BtreeNode::LoadNodeFrom(pager.get_page(page_id));
+        PageGuard guard(pager, page_id);
+        auto ptr = load_node(guard.data);
         if (page_id == pager.get_root_page())
-            is_valid = is_valid && (ptr->is_root()) && ptr->parent() == NODE_PARENT_INVALID;
+            is_valid = is_valid && (ptr->is_root());
         else
-            is_valid = is_valid && (!ptr->is_root()) && ptr->parent() != NODE_PARENT_INVALID;
+            is_valid = is_valid && (!ptr->is_root());
 
         if (!is_valid){
             cout << "root not correctly set" << endl;
             throw std::runtime_error("root not correctly set");
         }
 
-        if (!ptr->is_root())
-            is_valid = is_valid && ptr->get_num_keys() * 2 >= this->inner_node_load;
+        if (!ptr->is_root() && std::find(right_edge.begin(), right_edge.end(), page_id) == right_edge.end())
+            is_valid = is_valid && ptr->get_num_keys() >= min_inner_keys(*(InternalNode *)ptr.get());
         is_valid = is_valid && ptr->is_key_monotonic_increasing();
         if (!is_valid) throw std::runtime_error("load or key increasing not satisfied");
 
         auto inner_ptr = (InternalNode *) ptr.get();
         for (uint32_t i=0; i < inner_ptr->get_num_keys(); ++i)
         {
-            uint32_t key = inner_ptr->get_key(i);
-            auto lchild = BtreeNode::LoadNodeFrom(pager.get_page(inner_ptr->get_child(i)));
-            auto rchild = BtreeNode::LoadNodeFrom(pager.get_page(inner_ptr->get_child(i+1)));
+            Key key = inner_ptr->get_key(i);
+            PageGuard lguard(pager, inner_ptr->get_child(i));
+            PageGuard rguard(pager, inner_ptr->get_child(i+1));
+            auto lchild = load_node(lguard.data);
+            auto rchild = load_node(rguard.data);
 
-            is_valid = is_valid && lchild->parent() == page_id;
-            is_valid = is_valid && rchild->parent() == page_id;
-            if (!is_valid) {
-                cout << "left parent: " << lchild->parent() << " right parent" << rchild->parent() << " real " << page_id << endl;
-                throw std::runtime_error("parent and child not correctly linked");
-            }
+            if (lchild->is_root() || rchild->is_root())
+                throw std::runtime_error("child of an inner node marked as root");
 
             is_valid = is_valid && lchild->get_key(lchild->get_num_keys()-1) <= key;
             is_valid = is_valid && key < rchild->get_key(0);
@@ -405,15 +1839,56 @@ bool BPlusTree::check_valid()
         if (!is_valid) throw std::runtime_error("node is not valid");
     };
 
+    // leaves are visited in key order, each one links to its neighbours
+    uint64_t prev_leaf = PAGE_ID_INVALID;
+    std::function<void(uint64_t)> leaf_node_checker = [this, &prev_leaf](uint64_t page_id)
+    {
+        PageGuard guard(pager, page_id);
+        LeafNode leaf(guard.data);
+        if (leaf.prev_leaf() != prev_leaf)
+            throw std::runtime_error("leaf not linked to its left sibling");
+        if (!leaf.is_root() && leaf.next_leaf() != PAGE_ID_INVALID && leaf.num_cells() < min_leaf_cells(leaf))
+            throw std::runtime_error("leaf less than half loaded");
+
+        if (prev_leaf != PAGE_ID_INVALID)
+        {
+            PageGuard prev_guard(pager, prev_leaf);
+            if (LeafNode(prev_guard.data).next_leaf() != page_id)
+                throw std::runtime_error("leaf not linked to its right sibling");
+        }
+        prev_leaf = page_id;
+    };
+
     // cout << pager.get_root_page() << endl;
-    post_order_visit(pager.get_root_page(), inner_node_checker, nullptr, nullptr, 0, UINT32_MAX);
+    post_order_visit(pager.get_root_page(), inner_node_checker, leaf_node_checker, nullptr, std::nullopt, std::nullopt);
+
+    if (prev_leaf != PAGE_ID_INVALID)
+    {
+        PageGuard guard(pager, prev_leaf);
+        if (LeafNode(guard.data).next_leaf() != PAGE_ID_INVALID)
+            throw std::runtime_error("last leaf has a right sibling");
+    }
     return is_valid;
 }
 
-std::vector<void *> BPlusTree::select_cell(uint32_t min_val, uint32_t max_val)
+template <typename Key, uint32_t RowSize>
+std::vector<void *> BasicBPlusTree<Key, RowSize>::select_cell(Key min_val, Key max_val)
 {
+    // one descent then the leaf chain up to the first key past the range
     vector<void *> result;
-    function<void(void *)> leaf_cell_action = [&result](void * cell) { result.push_back(cell); };
-    post_order_visit(pager.get_root_page(), nullptr, nullptr, leaf_cell_action, min_val, max_val);
+    if (min_val > max_val)
+        return result;
+
+    for (auto cursor = seek(min_val); cursor.is_valid() && cursor.key() <= max_val; cursor.next())
+        result.push_back(cursor.cell());
     return result;
-}
\ No newline at end of file
+}
+
+template class BasicLeafCursor<uint32_t>;
+template class BasicLeafCursor<uint32_t, UserInfo::ROW_BYTE>;
+template class BasicLeafCursor<uint64_t>;
+template class BasicLeafCursor<std::string_view>;
+template class BasicBPlusTree<uint32_t>;
+template class BasicBPlusTree<uint32_t, UserInfo::ROW_BYTE>;
+template class BasicBPlusTree<uint64_t>;
+template class BasicBPlusTree<std::string_view>;
@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <climits>
 #include <cstdio>
@@ -7,31 +9,49 @@
 #include <exception>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
 #include "dbfile.h"
+#include "key_traits.h"
+#include "latch.h"
 #include "parameters.h"
 #include "row.h"
+#include "thread_pool.h"
+#include "wal.h"
 
 /**
  * @brief common header layer out
  * NODE_TYPE 1 byte
  * IS_ROOT 1 byte
- * PARENT_POINTER 8 byte
+ * RESERVED 6 byte: a page of the free list keeps the id of the next free page
+ *  in its first 8 bytes, the page lsn stays after it
+ * PAGE_LSN 8 byte: lsn of the last logged change of the page
+ * nodes keep no parent pointer, operations remember the path from the root
  */
 const uint32_t NODE_TYPE_SIZE = sizeof(uint8_t);
 const uint32_t NODE_TYPE_OFFSET = 0;
 const uint32_t IS_ROOT_SIZE = sizeof(uint8_t);
 const uint32_t IS_ROOT_OFFSET = NODE_TYPE_SIZE;
-const uint32_t PARENT_POINTER_SIZE = sizeof(uint64_t);
-const uint32_t PARENT_POINTER_OFFSET = IS_ROOT_OFFSET + IS_ROOT_SIZE;
-const uint32_t COMMON_NODE_HEADER_SIZE = NODE_TYPE_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE;
-const uint64_t NODE_PARENT_INVALID = ULONG_LONG_MAX;
+const uint32_t PAGE_LSN_SIZE = sizeof(uint64_t);
+const uint32_t PAGE_LSN_OFFSET = sizeof(uint64_t);
+const uint32_t COMMON_NODE_HEADER_SIZE = PAGE_LSN_OFFSET + PAGE_LSN_SIZE;
 const uint8_t NODE_TYPE_INNER = 0;
 const uint8_t NODE_TYPE_LEAF = 1;
 
-struct BtreeNode
+// row size of leaves whose rows are sized at runtime
+const uint32_t DYNAMIC_ROW_SIZE = 0;
+
+/**
+ * @brief node of a tree of keys Key, the keys are kept as described by
+ *  KeyTraits<Key>
+ */
+template <typename Key>
+struct BasicBtreeNode
 {
+    using Traits = KeyTraits<Key>;
+    using Stored = typename Traits::Stored;
+
     void * data; // pointer to a page
 
     virtual const uint8_t & node_type() const
@@ -48,8 +68,11 @@ struct BtreeNode
 
     virtual void set_root(bool is_root = true) { *((char *)data + IS_ROOT_OFFSET) = (int)is_root; }
 
-    // when current node's parent is not valid set it to -1
-    virtual uint64_t & parent() { return *(uint64_t *)((char *)data + PARENT_POINTER_OFFSET); }
+    // replay of the log skips records older than the page
+    virtual uint64_t & page_lsn() { return *(uint64_t *)((char *)data + PAGE_LSN_OFFSET); }
+
+    // bytes from the page start which hold the content of the node
+    virtual uint32_t used_bytes() const { throw std::runtime_error("not implemented"); }
 
     // get and set load of current node
     virtual uint32_t get_node_load() const { throw std::runtime_error("not implemented"); }
@@ -61,7 +84,7 @@ struct BtreeNode
 
     // get key according to its id, one can use this
     // function to change key value
-    virtual uint32_t & get_key(uint32_t key_id) { throw std::runtime_error("not implemented"); }
+    virtual Stored & get_key(uint32_t key_id) { throw std::runtime_error("not implemented"); }
 
     // check whether current node is full
     virtual bool isFull() { throw std::runtime_error("not implemented"); }
@@ -69,7 +92,7 @@ struct BtreeNode
     // search pos s.t. keys[pos] <= query_key < keys[pos+1]
     // pos == -1 if query_key < keys[0]
     // assumption: all keys in a nodes are distinct
-    virtual int search_key_position(uint32_t key)
+    virtual int search_key_position(Key key)
     {
         uint32_t n = get_num_keys();
         assert(n > 0);
@@ -78,7 +101,7 @@ struct BtreeNode
         while (start <= end)
         {
             int mid = start + (end - start) / 2;
-            uint32_t key_mid = get_key(mid);
+            Key key_mid = get_key(mid);
 
             if (key_mid == key)
                 return mid;
@@ -101,7 +124,7 @@ struct BtreeNode
         uint32_t n = get_num_keys();
 
         for (uint32_t i = 0; i + 1 < n; ++i)
-            if (get_key(i) == get_key(i + 1))
+            if (Key(get_key(i)) == Key(get_key(i + 1)))
                 return true;
 
 
@@ -112,7 +135,7 @@ struct BtreeNode
     virtual bool is_key_monotonic_increasing() {
         if (get_num_keys() <= 1) return true;
         for (uint32_t i = 0; i + 1 < get_num_keys(); ++i)
-            if (get_key(i) >= get_key(i+1)) return false;
+            if (Key(get_key(i)) >= Key(get_key(i+1))) return false;
 
         return true;
     }
@@ -127,18 +150,21 @@ struct BtreeNode
     }
 
     // static functions
-    static uint8_t get_node_type_from(void * page)
-    {
-        const uint8_t & value = *((uint8_t *)((char *)page + NODE_TYPE_OFFSET));
-        return value;
-    }
+    static uint8_t get_node_type_from(const void * page) { return *((const uint8_t *)page + NODE_TYPE_OFFSET); }
+
+    static uint64_t get_page_lsn_from(const void * page) { return *(const uint64_t *)((const char *)page + PAGE_LSN_OFFSET); }
 
-    // factory function to genrate node according to content in page
-    static std::unique_ptr<BtreeNode> LoadNodeFrom(void * page);
+    // also works for a page of the free list, whose first bytes link the next free page
+    static void set_page_lsn_of(void * page, uint64_t lsn) { *(uint64_t *)((char *)page + PAGE_LSN_OFFSET) = lsn; }
+
+    // factory function to genrate node according to content in page,
+    // leaves are read as BasicLeafNode<Key, RowSize>
+    template <uint32_t RowSize = DYNAMIC_ROW_SIZE>
+    static std::unique_ptr<BasicBtreeNode> LoadNodeFrom(void * page);
 
 protected:
     // constructor shall not be called
-    BtreeNode(void * page) : data(page)
+    BasicBtreeNode(void * page) : data(page)
     {
         // the page shall known
         // data = malloc(PAGE_SIZE);
@@ -147,7 +173,6 @@ protected:
         // constructor
         // defaultly the node is not a root node
         // set_root(false);
-        // parent() = NODE_PARENT_INVALID;
     }
 };
 
@@ -155,74 +180,171 @@ protected:
  * @brief header of leaf node layout
  * NUM_CELLS 4 byte
  * row_size 4 byte
+ * NEXT_LEAF 8 byte: page id of the right sibling, PAGE_ID_INVALID for the last leaf
+ * PREV_LEAF 8 byte: page id of the left sibling, PAGE_ID_INVALID for the first leaf
+ * HEAP_TOP 4 byte: heap slots handed out since the heap was compacted
  */
 const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
 const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
 const uint32_t LEAF_NODE_ROWSIZE_SIZE = sizeof(uint32_t);
 const uint32_t LEAF_NODE_ROWSIZE_OFFSET = LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE;
-const uint32_t LEAF_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_ROWSIZE_SIZE;
+const uint32_t LEAF_NODE_SIBLING_SIZE = sizeof(uint64_t);
+const uint32_t LEAF_NODE_NEXT_OFFSET = LEAF_NODE_ROWSIZE_OFFSET + LEAF_NODE_ROWSIZE_SIZE;
+const uint32_t LEAF_NODE_PREV_OFFSET = LEAF_NODE_NEXT_OFFSET + LEAF_NODE_SIBLING_SIZE;
+const uint32_t LEAF_NODE_HEAP_TOP_SIZE = sizeof(uint32_t);
+const uint32_t LEAF_NODE_HEAP_TOP_OFFSET = LEAF_NODE_PREV_OFFSET + LEAF_NODE_SIBLING_SIZE;
+const uint32_t LEAF_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + LEAF_NODE_NUM_CELLS_SIZE + LEAF_NODE_ROWSIZE_SIZE
+    + 2 * LEAF_NODE_SIBLING_SIZE + LEAF_NODE_HEAP_TOP_SIZE;
 
 /**
- * @brief layout of payload (key, value)
- *
+ * @brief slotted page of a leaf, the header is followed by
+ * KEYS capacity * key size: sorted keys of the cells
+ * SLOTS capacity * 2 byte: heap slot of the cell of each key
+ * HEAP capacity * cell_size: cells (key, value) in the order they were added
+ * an insert or a remove moves keys and slots only. a removed cell stays in
+ * the heap until the heap is used up, then the cells are compacted
  */
-const uint32_t LEAF_NODE_KEY_SIZE = sizeof(uint32_t);
-const uint32_t LEAF_NODE_KEY_OFFSET = 0;
-const uint32_t LEAF_NODE_VALUE_OFFSET = LEAF_NODE_KEY_OFFSET + LEAF_NODE_KEY_SIZE;
-const uint32_t LEAF_NODE_SPACE_FOR_CELLS = PAGE_SIZE - LEAF_NODE_HEADER_SIZE;
+const uint32_t LEAF_NODE_SLOT_SIZE = sizeof(uint16_t);
 
+/**
+ * @brief layout of internal node
+ * INTERNAL_NODE 4 byte
+ * load: (pointer0, key0 ... pointer(n-1), key(n-1), pointer(n))
+ *  stored as the array of keys followed by the array of pointers, so that
+ *  a search reads a few cache lines of keys only
+ * since Nodes shall persist into disk we use id of page to fill the pointers
+ */
+const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
+const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
+const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE;
+const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint64_t);
+
+constexpr uint32_t align_up(uint32_t offset, uint32_t alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
 
 /**
- * @brief leafnode of b+tree
- *
+ * @brief offsets and capacities of the nodes of keys Key, the arrays of
+ *  keys start aligned to their entries
  */
-struct LeafNode : public BtreeNode
+template <typename Key>
+struct NodeLayout
 {
-    uint32_t row_size; // size of a row
-    uint32_t cell_size; // concate of key and row
-    uint32_t num_max_cell; // shall never change them
+    using Stored = typename KeyTraits<Key>::Stored;
+    static constexpr uint32_t KEY_SIZE = sizeof(Stored);
+
+    // a cell is (key, value)
+    static constexpr uint32_t LEAF_KEYS_OFFSET = align_up(LEAF_NODE_HEADER_SIZE, alignof(Stored));
+    static constexpr uint32_t LEAF_VALUE_OFFSET = KEY_SIZE;
+    static constexpr uint32_t LEAF_SPACE_FOR_CELLS = PAGE_SIZE - LEAF_KEYS_OFFSET;
+
+    // number of cells of a leaf, kept even so that the load of tree is even
+    static constexpr uint32_t leaf_capacity(uint32_t cell_size)
+    {
+        uint32_t capacity = LEAF_SPACE_FOR_CELLS / (KEY_SIZE + LEAF_NODE_SLOT_SIZE + cell_size);
+        return capacity - capacity % 2;
+    }
+    static constexpr uint32_t leaf_slots_offset(uint32_t capacity) { return LEAF_KEYS_OFFSET + capacity * KEY_SIZE; }
+    static constexpr uint32_t leaf_heap_offset(uint32_t capacity) { return leaf_slots_offset(capacity) + capacity * LEAF_NODE_SLOT_SIZE; }
+
+    // even number of keys which fit with one more pointer and the alignment of pointers
+    static constexpr uint32_t INTERNAL_KEYS_OFFSET = align_up(INTERNAL_NODE_HEADER_SIZE, alignof(Stored));
+    static constexpr uint32_t INTERNAL_MAX_KEYS
+        = (PAGE_SIZE - INTERNAL_KEYS_OFFSET - 2 * INTERNAL_NODE_CHILD_SIZE) / (KEY_SIZE + INTERNAL_NODE_CHILD_SIZE) / 2 * 2;
+    static constexpr uint32_t INTERNAL_CHILDREN_OFFSET = align_up(INTERNAL_KEYS_OFFSET + INTERNAL_MAX_KEYS * KEY_SIZE, INTERNAL_NODE_CHILD_SIZE);
+    static_assert(INTERNAL_CHILDREN_OFFSET + (INTERNAL_MAX_KEYS + 1) * INTERNAL_NODE_CHILD_SIZE <= PAGE_SIZE, "inner node overflows its page");
+};
+
+/**
+ * @brief sizes and offsets of the cells of a leaf with rows of RowSize
+ *  bytes. they are constants, so the address arithmetic of a cell folds
+ *  into the code. the page format does not depend on it
+ */
+template <typename Key, uint32_t RowSize>
+struct LeafCellLayout
+{
+    using Layout = NodeLayout<Key>;
+
+    static constexpr uint32_t row_size = RowSize;
+    static constexpr uint32_t cell_size = Layout::KEY_SIZE + RowSize;
+    static constexpr uint32_t capacity = Layout::leaf_capacity(cell_size);
+    static constexpr uint32_t slots_offset = Layout::leaf_slots_offset(capacity);
+    static constexpr uint32_t heap_offset = Layout::leaf_heap_offset(capacity);
+    static_assert(capacity > 0, "row does not fit into a leaf");
 
-    LeafNode(void * page, uint32_t row_size) : BtreeNode(page), row_size(row_size)
+    explicit LeafCellLayout(uint32_t size) { assert(size == RowSize); }
+};
+
+// rows sized at runtime, e.g. by a schema read from a file
+template <typename Key>
+struct LeafCellLayout<Key, DYNAMIC_ROW_SIZE>
+{
+    using Layout = NodeLayout<Key>;
+
+    uint32_t row_size;
+    uint32_t cell_size; // concate of key and row
+    uint32_t capacity; // cells the page has room for
+    uint32_t slots_offset;
+    uint32_t heap_offset;
+
+    explicit LeafCellLayout(uint32_t size)
+        : row_size(size),
+          cell_size(Layout::KEY_SIZE + size),
+          capacity(Layout::leaf_capacity(cell_size)),
+          slots_offset(Layout::leaf_slots_offset(capacity)),
+          heap_offset(Layout::leaf_heap_offset(capacity))
     {
-        cell_size = sizeof(uint32_t) + row_size;
-        num_max_cell = LEAF_NODE_SPACE_FOR_CELLS / cell_size;
+        assert(capacity > 0);
+    }
+};
 
-        // enforce that the load of tree is even
-        if (num_max_cell % 2 == 1)
-            num_max_cell -= 1;
 
+/**
+ * @brief leafnode of b+tree
+ * RowSize: size of a row when it is fixed by the schema, DYNAMIC_ROW_SIZE
+ *  takes it from the page
+ */
+template <typename Key, uint32_t RowSize = DYNAMIC_ROW_SIZE>
+struct BasicLeafNode final : public BasicBtreeNode<Key>, public LeafCellLayout<Key, RowSize>
+{
+    using Node = BasicBtreeNode<Key>;
+    using Traits = KeyTraits<Key>;
+    using Stored = typename Traits::Stored;
+    using Layout = NodeLayout<Key>;
+    using Cells = LeafCellLayout<Key, RowSize>;
+    using Node::data;
+    using Cells::row_size;
+    using Cells::cell_size;
+    using Cells::capacity;
+
+    uint32_t num_max_cell; // load, at most capacity
+
+    BasicLeafNode(void * page, uint32_t row_size) : Node(page), Cells(row_size), num_max_cell(capacity)
+    {
         // set num_cell to 0
         num_cells() = 0;
-
-        assert(num_max_cell > 0);
+        heap_top() = 0;
 
         // set node type
         *((uint8_t *)((char *)data + NODE_TYPE_OFFSET)) = NODE_TYPE_LEAF;
 
         // set row size
         *get_rowsize_ptr() = row_size;
+
+        // a new leaf is not linked to any sibling
+        next_leaf() = PAGE_ID_INVALID;
+        prev_leaf() = PAGE_ID_INVALID;
     }
 
     // build node directly from page
-    LeafNode(void * page) : BtreeNode(page)
-    {
-        row_size = *get_rowsize_ptr();
-
-        cell_size = sizeof(uint32_t) + row_size;
-        num_max_cell = LEAF_NODE_SPACE_FOR_CELLS / cell_size;
-
-        // enforce that the load of tree is even
-        if (num_max_cell % 2 == 1)
-            num_max_cell -= 1;
-
-        assert(num_max_cell > 0);
-    }
+    BasicLeafNode(void * page) : Node(page), Cells(row_size_of(page)), num_max_cell(capacity) { }
 
     virtual uint32_t get_node_load() const override { return num_max_cell; }
 
     virtual void set_node_load(uint32_t size) override
     {
-        assert(size % 2 == 0 && size > 0);
+        assert(size % 2 == 0 && size > 0 && size <= capacity);
         num_max_cell = size;
     }
 
@@ -232,8 +354,16 @@ struct LeafNode : public BtreeNode
         return *num_cells_ptr;
     }
 
+    // the heap ends behind the last slot handed out
+    virtual uint32_t used_bytes() const override { return Cells::heap_offset + heap_top_of(data) * cell_size; }
+
     // get pointer to row_size
     uint32_t * get_rowsize_ptr() { return (uint32_t *)((char *)data + LEAF_NODE_ROWSIZE_OFFSET); }
+    static uint32_t row_size_of(const void * page) { return *(const uint32_t *)((const char *)page + LEAF_NODE_ROWSIZE_OFFSET); }
+
+    // leaves form a doubly linked list in key order
+    uint64_t & next_leaf() { return *(uint64_t *)((char *)data + LEAF_NODE_NEXT_OFFSET); }
+    uint64_t & prev_leaf() { return *(uint64_t *)((char *)data + LEAF_NODE_PREV_OFFSET); }
 
     // num of (key, value) pairs
     // note that :: add num_cells by one when new row inserted
@@ -243,71 +373,95 @@ struct LeafNode : public BtreeNode
         return *num_cells_ptr;
     }
 
+    uint32_t & heap_top() { return *(uint32_t *)((char *)data + LEAF_NODE_HEAP_TOP_OFFSET); }
+    static uint32_t heap_top_of(const void * page) { return *(const uint32_t *)((const char *)page + LEAF_NODE_HEAP_TOP_OFFSET); }
+
+    Stored * keys() { return (Stored *)((char *)data + Layout::LEAF_KEYS_OFFSET); }
+    uint16_t * slots() { return (uint16_t *)((char *)data + Cells::slots_offset); }
+    char * heap_cell(uint32_t slot) { return (char *)data + Cells::heap_offset + slot * cell_size; }
+
     // pair of (key, val)
     // cell_num < leaf_node_num_cells
     void * get_cell(uint32_t cell_num)
     {
         assert(cell_num < num_cells());
-        return (char *)data + LEAF_NODE_HEADER_SIZE + cell_num * cell_size;
+        return heap_cell(slots()[cell_num]);
     }
 
-    // allocate new cell from the page
-    // when no slot available return nullptr
-    void * allocate_cell()
+    // append a cell with key behind the last one, key shall be larger
+    // than every key of the node. when no slot available return nullptr
+    void * allocate_cell(Key key)
     {
         uint32_t m = num_cells();
         if (m == num_max_cell)
             return nullptr;
 
-        void * pos = (char *)data + LEAF_NODE_HEADER_SIZE + m * cell_size;
-
+        uint32_t slot = allocate_heap_slot();
+        char * cell = heap_cell(slot);
+        slots()[m] = slot;
+        keys()[m] = key;
+        *extract_key(cell) = key;
         num_cells() += 1;
-        return pos;
+        return cell;
     }
 
-    // get key of a cell
-    virtual uint32_t & get_key(uint32_t cell_num) override { return *((uint32_t *)get_cell(cell_num)); }
+    // get key of a cell, the key array is the index of the cells: keys
+    // shall not be changed once their cells are added
+    virtual Stored & get_key(uint32_t cell_num) override
+    {
+        assert(cell_num < num_cells());
+        return keys()[cell_num];
+    }
+
+    // pos s.t. keys[pos] <= key < keys[pos+1] by a search of the key array
+    virtual int search_key_position(Key key) override
+    {
+        int pos = Traits::lower_bound(keys(), num_cells(), key);
+        return pos < (int)num_cells() && keys()[pos] == key ? pos : pos - 1;
+    }
 
     // pointer to value content, shall deserialize using row object
     void * get_value(uint32_t cell_num)
     {
         void * cell_ptr = get_cell(cell_num);
-        return (char *)cell_ptr + LEAF_NODE_VALUE_OFFSET;
+        return (char *)cell_ptr + Layout::LEAF_VALUE_OFFSET;
     }
 
-    bool is_duplicate(uint32_t key)
+    bool is_duplicate(Key key)
     {
         for (uint32_t i = 0; i < num_cells(); ++i)
-            if (get_key(i) == key)
+            if (keys()[i] == key)
                 return true;
         return false;
     }
 
     // duplicate is not checked using this method
     // insert (key, value) into the page make the page sorted by key
-    void insert(uint32_t key, Row * value)
+    void insert(Key key, Row * value) { value->serialize(extract_value(open_cell(key))); }
+
+    // insert a cell (key, serialized row) copied from another leaf
+    void insert_cell(const void * cell) { memcpy(open_cell(*(const Stored *)cell), cell, cell_size); }
+
+    // make room for key at its sorted position, return the cell with key set
+    void * open_cell(Key key)
     {
         assert(num_cells() < num_max_cell);
-        auto m = num_cells();
 
-        // allocate a place for the newly insert row
-        allocate_cell();
-        auto i = m;
-        while (i >= 1 && get_key(i - 1) > key)
-        {
-            // copy cell[i-1] to cell[i]
-            memcpy(get_cell(i), get_cell(i - 1), cell_size);
-            i -= 1;
-        }
+        // only the keys and slots behind the new key move
+        uint32_t slot = allocate_heap_slot();
+        uint32_t n = num_cells();
+        uint32_t pos = Traits::lower_bound(keys(), n, key);
+        memmove(keys() + pos + 1, keys() + pos, (n - pos) * Layout::KEY_SIZE);
+        memmove(slots() + pos + 1, slots() + pos, (n - pos) * LEAF_NODE_SLOT_SIZE);
+        keys()[pos] = key;
+        slots()[pos] = slot;
+        num_cells() += 1;
 
-        // i == 0 or get_key(i-1) < key
-        get_key(i) = key;
-        value->serialize(get_value(i));
+        char * cell = heap_cell(slot);
+        *extract_key(cell) = key;
+        return cell;
     }
 
-    // static void copy_cell(int cell_id) {
-
-    // }
     virtual bool isFull() override { return num_cells() == num_max_cell; }
 
     // when current node is overloaded, split it into two
@@ -320,82 +474,134 @@ struct LeafNode : public BtreeNode
      * @param key
      * @param value
      * @param new_page: address of new page which is not used by any node
-     * @return uint32_t: pivot key whitch is the max key of left page
+     * @param page_id: page id of current node
+     * @param new_page_id: page id of new_page, it becomes the right sibling
+     *  of current node. the old right sibling shall link back to it
+     * @param append: key comes after every key of the last leaf, the node
+     *  keeps 90% of the cells since the next keys go to the right
+     * @return pivot key: separator of the max key of left page and the
+     *  min key of right page
      */
-    uint32_t insert_and_split(uint32_t key, Row * value, void * new_page)
+    typename Traits::Value insert_and_split(Key key, Row * value, void * new_page, uint64_t page_id, uint64_t new_page_id, bool append = false)
     {
-        // printf("enter\n");
         assert(isFull());
         // set statics of new_page
-        LeafNode rightNode(new_page, row_size);
+        BasicLeafNode rightNode(new_page, row_size);
+        rightNode.next_leaf() = next_leaf();
+        rightNode.prev_leaf() = page_id;
+        next_leaf() = new_page_id;
 
         // when leftNode is full -> left(full/2+1)  right(full/2)
-        // find max i s.t. key < cell(i)
-        // printf("start compare, num_cell=%d\n", num_cells());
-        int n = num_cells();
-        int key_pos = n;
-        while (key_pos > 0 && get_key(key_pos - 1) > key)
-            key_pos -= 1;
-        // printf("key_pos=%d\n", key_pos);
-        // key_pos == 0 or get_key(key_pos-1) <= key
-        assert(key_pos == 0 && key < get_key(key_pos) || key_pos > 0 && get_key(key_pos - 1) < key);
         // key shall insert at key_pos
-        //printf("End compare\n");
+        uint32_t n = num_cells();
+        uint32_t key_pos = Traits::lower_bound(keys(), n, key);
+        assert(key_pos == n || key < get_key(key_pos));
+
+        // the cells behind the left part move in bulk, then the new key
+        // goes to its side
+        assert(!append || key_pos == n);
+        uint32_t left_load = append ? n + 1 - std::max(1u, (n + 1) / 10) : n / 2 + 1;
+        if (key_pos < left_load)
+        {
+            shift_to_right(rightNode, n - left_load + 1);
+            insert(key, value);
+        }
+        else
+        {
+            shift_to_right(rightNode, n - left_load);
+            rightNode.insert(key, value);
+        }
 
-        // allocate memory in right node
-        int left_load = n / 2 + 1, right_load = n / 2;
-        for (int i = 0; i < right_load; ++i)
-            rightNode.allocate_cell();
+        assert(num_cells() == left_load);
+        return Traits::separator(get_key(left_load - 1), rightNode.get_key(0));
+    }
 
-        // move old key & value pair into
-        // left node and right node
-        for (int i = n - 1; i >= 0; --i)
-        {
-            int idx = i + (key_pos <= i);
+    void initialize_leaf_node(void * node) { num_cells() = 0; }
 
-            // insert to left node with new id: idx
-            if (idx < left_load)
-            {
-                // move from i to idx
-                if (i != idx)
-                    memcpy(get_cell(idx), get_cell(i), cell_size);
+    // remove count cells starting at cell_num, keys and slots behind them move forward
+    void remove_cells(uint32_t cell_num, uint32_t count)
+    {
+        assert(cell_num + count <= num_cells());
+        uint32_t tail = num_cells() - cell_num - count;
+        memmove(keys() + cell_num, keys() + cell_num + count, tail * Layout::KEY_SIZE);
+        memmove(slots() + cell_num, slots() + cell_num + count, tail * LEAF_NODE_SLOT_SIZE);
+        num_cells() -= count;
+
+        if (num_cells() == 0)
+            heap_top() = 0;
+    }
 
-                // insert to right node
-            }
-            else
-            {
-                memcpy(rightNode.get_cell(idx - left_load), get_cell(i), cell_size);
-            }
-        }
-        // printf("key inserted\n");
+    // move the last count cells of this node to the front of right
+    void shift_to_right(BasicLeafNode & right, uint32_t count) { move_cells(num_cells() - count, count, right, 0); }
 
-        // insert key_pos
-        if (key_pos < left_load)
-        {
-            get_key(key_pos) = key;
-            value->serialize(get_value(key_pos));
-        }
-        else
+    // move the first count cells of this node to the end of left
+    void shift_to_left(BasicLeafNode & left, uint32_t count) { move_cells(0, count, left, left.num_cells()); }
+
+    // move count cells starting at cell_num to position dst_num of dst,
+    // cells which lie side by side in the heap are copied together
+    void move_cells(uint32_t cell_num, uint32_t count, BasicLeafNode & dst, uint32_t dst_num)
+    {
+        assert(cell_num + count <= num_cells() && dst.num_cells() + count <= dst.num_max_cell);
+        assert(dst.cell_size == cell_size && dst_num <= dst.num_cells());
+
+        // the heap slots of dst are taken before its slots move
+        if (dst.heap_top() + count > dst.capacity)
+            dst.compact_heap();
+        uint32_t first_slot = dst.heap_top();
+        dst.heap_top() += count;
+
+        uint32_t m = dst.num_cells();
+        memmove(dst.keys() + dst_num + count, dst.keys() + dst_num, (m - dst_num) * Layout::KEY_SIZE);
+        memmove(dst.slots() + dst_num + count, dst.slots() + dst_num, (m - dst_num) * LEAF_NODE_SLOT_SIZE);
+        memcpy(dst.keys() + dst_num, keys() + cell_num, count * Layout::KEY_SIZE);
+
+        uint16_t * src_slots = slots() + cell_num;
+        for (uint32_t i = 0; i < count;)
         {
-            rightNode.get_key(key_pos - left_load) = key;
-            value->serialize(rightNode.get_value(key_pos - left_load));
+            uint32_t run = 1;
+            while (i + run < count && src_slots[i + run] == src_slots[i] + run)
+                run += 1;
+            memcpy(dst.heap_cell(first_slot + i), heap_cell(src_slots[i]), run * cell_size);
+            for (uint32_t k = i; k < i + run; ++k)
+                dst.slots()[dst_num + k] = first_slot + k;
+            i += run;
         }
+        dst.num_cells() += count;
 
-        // addjust left node size to left_load
-        num_cells() = left_load;
+        remove_cells(cell_num, count);
+    }
 
-        return get_key(left_load - 1);
+    // take a free slot of the heap, the heap is compacted once every slot
+    // was handed out
+    uint32_t allocate_heap_slot()
+    {
+        if (heap_top() == capacity)
+            compact_heap();
+        assert(heap_top() < capacity);
+        return heap_top()++;
     }
 
-    void initialize_leaf_node(void * node) { num_cells() = 0; }
+    // cell i moves to heap slot i
+    void compact_heap()
+    {
+        char buffer[PAGE_SIZE];
+        uint32_t n = num_cells();
+        for (uint32_t i = 0; i < n; ++i)
+        {
+            memcpy(buffer + i * cell_size, heap_cell(slots()[i]), cell_size);
+            slots()[i] = i;
+        }
+        memcpy(heap_cell(0), buffer, n * cell_size);
+        heap_top() = n;
+    }
 
     /*
     ROW_SIZE: 68
-    COMMON_NODE_HEADER_SIZE: 10
-    LEAF_NODE_HEADER_SIZE: 14
+    COMMON_NODE_HEADER_SIZE: 16
+    LEAF_NODE_HEADER_SIZE: 44
     LEAF_NODE_CELL_SIZE: 72
-    LEAF_NODE_SPACE_FOR_CELLS: 4082
-    LEAF_NODE_MAX_CELLS: 56
+    LEAF_NODE_SPACE_FOR_CELLS: 4052
+    LEAF_NODE_MAX_CELLS: 50
     */
     void print_constants()
     {
@@ -403,7 +609,7 @@ struct LeafNode : public BtreeNode
         printf("COMMON_NODE_HEADER_SIZE: %d\n", COMMON_NODE_HEADER_SIZE);
         printf("LEAF_NODE_HEADER_SIZE: %d\n", LEAF_NODE_HEADER_SIZE);
         printf("LEAF_NODE_CELL_SIZE: %d\n", cell_size);
-        printf("LEAF_NODE_SPACE_FOR_CELLS: %d\n", LEAF_NODE_SPACE_FOR_CELLS);
+        printf("LEAF_NODE_SPACE_FOR_CELLS: %d\n", Layout::LEAF_SPACE_FOR_CELLS);
         printf("LEAF_NODE_MAX_CELLS: %d\n", num_max_cell);
     }
 
@@ -411,34 +617,27 @@ struct LeafNode : public BtreeNode
     {
         printf("leaf (size %d)\n", num_cells());
         for (uint32_t i = 0; i < num_cells(); i++)
-        {
-            uint32_t key = get_key(i);
-            printf("  - %d : %d\n", i, key);
-        }
+            printf("  - %d : %s\n", i, Traits::to_string(get_key(i)).c_str());
     }
 
-    inline static uint32_t * extract_key(void * cell) { return (uint32_t *)cell; }
+    inline static Stored * extract_key(void * cell) { return (Stored *)cell; }
 
-    inline static void * extract_value(void * cell) { return (char *)cell + LEAF_NODE_VALUE_OFFSET; }
+    inline static void * extract_value(void * cell) { return (char *)cell + Layout::LEAF_VALUE_OFFSET; }
 };
 
-/**
- * @brief layout of internal node
- * INTERNAL_NODE 4 byte
- * load: (pointer0, key0 ... pointer(n-1), key(n-1), pointer(n))
- * since Nodes shall persist into disk we use id of page to fill the pointers
- */
-const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
-const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
-const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE;
-const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
-const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint64_t);
-struct InternalNode : public BtreeNode
+template <typename Key>
+struct BasicInternalNode final : public BasicBtreeNode<Key>
 {
+    using Node = BasicBtreeNode<Key>;
+    using Traits = KeyTraits<Key>;
+    using Stored = typename Traits::Stored;
+    using Layout = NodeLayout<Key>;
+    using Node::data;
+
     uint32_t num_max_keys; // init to even
 
 
-    InternalNode(void * page, bool reset = false) : BtreeNode(page)
+    BasicInternalNode(void * page, bool reset = false) : Node(page)
     {
         if (reset)
         {
@@ -448,10 +647,7 @@ struct InternalNode : public BtreeNode
         }
 
         // set num of max keys
-        // since data loading is of form (p0,k0,p1,k1...,pn-1,kn-1,pn)
-        uint32_t payload_size = PAGE_SIZE - INTERNAL_NODE_HEADER_SIZE;
-        uint32_t max_num_cell = (payload_size - INTERNAL_NODE_CHILD_SIZE) / (INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE);
-        num_max_keys = max_num_cell % 2 ? max_num_cell - 1 : max_num_cell;
+        num_max_keys = Layout::INTERNAL_MAX_KEYS;
     }
 
     virtual uint32_t get_node_load() const override { return num_max_keys; }
@@ -480,27 +676,30 @@ struct InternalNode : public BtreeNode
         return (uint32_t *)pos;
     }
 
+    // keys up to the pointers followed by p0 ... pn
+    virtual uint32_t used_bytes() const override { return Layout::INTERNAL_CHILDREN_OFFSET + (get_num_keys() + 1) * INTERNAL_NODE_CHILD_SIZE; }
+
+    Stored * keys() { return (Stored *)((char *)data + Layout::INTERNAL_KEYS_OFFSET); }
 
     // get key of a cell
-    // key is of form (p0,k0,....)
-    virtual uint32_t & get_key(uint32_t id) override
+    virtual Stored & get_key(uint32_t id) override
     {
         assert(id < num_max_keys);
-
-        char * start = (char *)data + INTERNAL_NODE_HEADER_SIZE;
-        char * pos = start + id * (INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE) + INTERNAL_NODE_CHILD_SIZE;
-
-        return *((uint32_t *)pos);
+        return keys()[id];
     }
 
     // get value from a cell
     uint64_t & get_child(uint32_t id)
     {
         assert(id <= num_max_keys);
-        char * start = (char *)data + INTERNAL_NODE_HEADER_SIZE;
-        char * pos = start + id * (INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE);
+        return ((uint64_t *)((char *)data + Layout::INTERNAL_CHILDREN_OFFSET))[id];
+    }
 
-        return *((uint64_t *)pos);
+    // pos s.t. keys[pos] <= key < keys[pos+1] by a search of the key array
+    virtual int search_key_position(Key key) override
+    {
+        int pos = Traits::lower_bound(keys(), num_keys(), key);
+        return pos < (int)num_keys() && keys()[pos] == key ? pos : pos - 1;
     }
 
     // set value of a child
@@ -521,7 +720,7 @@ struct InternalNode : public BtreeNode
      * @param left page id of left node, assume that all keys in left tree <= key
      * @param right page id of right node. assume all key in right tree > key
      */
-    void insert(uint32_t key, uint64_t left, uint64_t right)
+    void insert(Key key, uint64_t left, uint64_t right)
     {
         int n = num_keys();
         num_keys() += 1;
@@ -568,16 +767,34 @@ struct InternalNode : public BtreeNode
      * @param left page id of the left child
      * @param right page id of the right child
      * @param new_page
-     * @return uint32_t
+     * @param append: key comes after every key of the last node of its
+     *  level, the node keeps 90% of the keys since the next keys go right
+     * @return pivot key
      */
-    uint32_t insert_and_split(uint32_t key, uint64_t left, uint64_t right, void * new_page)
+    typename Traits::Value insert_and_split(Key key, uint64_t left, uint64_t right, void * new_page, bool append = false)
     {
         // interprete new page as a new inner node
-        InternalNode rightNode(new_page, true);
+        BasicInternalNode rightNode(new_page, true);
 
         // allocate n/2 new entries in right node
         assert(isFull());
         int n = num_keys();
+
+        // (kp+1 ... kn-1, key) go right and kp moves up
+        if (append)
+        {
+            assert(Key(get_key(n - 1)) < key && get_child(n) == left);
+            int pivot_pos = n - std::max(1, (n + 1) / 10);
+            rightNode.get_child(0) = get_child(pivot_pos + 1);
+            for (int i = pivot_pos + 1; i < n; ++i)
+                rightNode.append(get_key(i), get_child(i + 1));
+            rightNode.append(key, right);
+
+            auto pivot_key = typename Traits::Value(Key(get_key(pivot_pos)));
+            num_keys() = pivot_pos;
+            return pivot_key;
+        }
+
         rightNode.num_keys() = n / 2;
 
         // locate the position to insert current key
@@ -652,7 +869,7 @@ struct InternalNode : public BtreeNode
         }
 
         // remove tail elements of current node
-        uint32_t pivot_key = get_key(pivot_pos);
+        auto pivot_key = typename Traits::Value(Key(get_key(pivot_pos)));
         num_keys() = n / 2;
 
         // return the pivot of these keys which is
@@ -669,7 +886,7 @@ struct InternalNode : public BtreeNode
      * @return false: search failed, duplicate found. in this
      *  circumstoms pos is set to the index of key
      */
-    bool search_insert_location(uint32_t key, int & pos)
+    bool search_insert_location(Key key, int & pos)
     {
         // int start = 0, end = num_keys() - 1;
         // while (start <= end)
@@ -713,20 +930,143 @@ struct InternalNode : public BtreeNode
 
     virtual bool isFull() override { return num_keys() == num_max_keys; }
 
-    // max_num_keys: 338
+    // (kn, pn+1) is added behind the last child
+    void append(Key key, uint64_t child)
+    {
+        uint32_t n = num_keys();
+        get_key(n) = key;
+        get_child(n + 1) = child;
+        num_keys() += 1;
+    }
+
+    // (p0, k0) is added in front of the first child
+    void prepend(uint64_t child, Key key)
+    {
+        uint32_t n = num_keys();
+        get_child(n + 1) = get_child(n);
+        for (int i = n - 1; i >= 0; --i)
+        {
+            get_key(i + 1) = get_key(i);
+            get_child(i + 1) = get_child(i);
+        }
+        get_key(0) = key;
+        get_child(0) = child;
+        num_keys() += 1;
+    }
+
+    // remove key_id and the child on its right
+    void remove_key_and_right_child(uint32_t key_id)
+    {
+        uint32_t n = num_keys();
+        assert(key_id < n);
+        for (uint32_t i = key_id; i + 1 < n; ++i)
+        {
+            get_key(i) = get_key(i + 1);
+            get_child(i + 1) = get_child(i + 2);
+        }
+        num_keys() -= 1;
+    }
+
+    // remove the first child and the key on its right
+    void remove_first()
+    {
+        uint32_t n = num_keys();
+        assert(n > 0);
+        for (uint32_t i = 0; i + 1 < n; ++i)
+        {
+            get_child(i) = get_child(i + 1);
+            get_key(i) = get_key(i + 1);
+        }
+        get_child(n - 1) = get_child(n);
+        num_keys() -= 1;
+    }
+
+    // max_num_keys: 338 for keys of 4 bytes
     void print_node()
     {
         printf("inner node (size %d)\n", num_keys());
         for (uint32_t i = 0; i < num_keys(); i++)
         {
             uint64_t child = get_child(i);
-            uint32_t key = get_key(i);
-            printf("%lld <= %d < ", child, key);
+            printf("%lld <= %s < ", child, Traits::to_string(get_key(i)).c_str());
         }
         printf("%lld\n", get_child(num_keys()));
     }
 };
 
+template <typename Key>
+template <uint32_t RowSize>
+std::unique_ptr<BasicBtreeNode<Key>> BasicBtreeNode<Key>::LoadNodeFrom(void * page)
+{
+    // build root node according to its type
+    auto node_type = get_node_type_from(page);
+    std::unique_ptr<BasicBtreeNode> node;
+    switch (node_type)
+    {
+        case NODE_TYPE_INNER:
+            node = std::make_unique<BasicInternalNode<Key>>(page, false);
+            break;
+
+        case NODE_TYPE_LEAF:
+            node = std::make_unique<BasicLeafNode<Key, RowSize>>(page);
+            break;
+
+        default:
+            throw std::runtime_error("Unknown Node Type");
+            break;
+    }
+
+    return node;
+}
+
+/**
+ * @brief read only views of a node for the lookup path. the type byte of
+ *  the page is checked once, then the matching view reads keys and
+ *  children without virtual calls. a view lives on the stack and never
+ *  allocates
+ */
+template <typename Key>
+struct BasicLeafView
+{
+    using Traits = KeyTraits<Key>;
+    using Stored = typename Traits::Stored;
+    using Layout = NodeLayout<Key>;
+
+    const char * data;
+
+    explicit BasicLeafView(const void * page) : data((const char *)page) { }
+
+    inline uint32_t num_cells() const { return *(const uint32_t *)(data + LEAF_NODE_NUM_CELLS_OFFSET); }
+    inline uint64_t next_leaf() const { return *(const uint64_t *)(data + LEAF_NODE_NEXT_OFFSET); }
+    inline const Stored * keys() const { return (const Stored *)(data + Layout::LEAF_KEYS_OFFSET); }
+    inline Key key(uint32_t cell_num) const { return keys()[cell_num]; }
+
+    // first cell with key >= query, num_cells() when every key is less
+    inline uint32_t lower_bound(Key query) const { return Traits::lower_bound(keys(), num_cells(), query); }
+};
+
+template <typename Key>
+struct BasicInnerView
+{
+    using Traits = KeyTraits<Key>;
+    using Stored = typename Traits::Stored;
+    using Layout = NodeLayout<Key>;
+
+    const char * data;
+
+    explicit BasicInnerView(const void * page) : data((const char *)page) { }
+
+    inline uint32_t num_keys() const { return *(const uint32_t *)(data + INTERNAL_NODE_NUM_KEYS_OFFSET); }
+
+    inline const Stored * keys() const { return (const Stored *)(data + Layout::INTERNAL_KEYS_OFFSET); }
+    inline Key key(uint32_t id) const { return keys()[id]; }
+    inline uint64_t child(uint32_t id) const { return ((const uint64_t *)(data + Layout::INTERNAL_CHILDREN_OFFSET))[id]; }
+
+    // slot of the child whose subtree may hold query: key_i is the max key
+    // of child i, so it is the first key >= query, num_keys() when none is
+    inline uint32_t child_slot(Key query) const { return Traits::lower_bound(keys(), num_keys(), query); }
+};
+
 struct KeyLocation
 {
     // page id which should contains the key
@@ -743,6 +1083,49 @@ struct KeyLocation
     KeyLocation(uint64_t page_id, uint32_t row_id, bool is_exist) : page_id(page_id), row_id(row_id), is_exist(is_exist) { }
 };
 
+/**
+ * @brief position on a cell of the leaf chain which moves in key order
+ *  in both directions. the leaf under the cursor is pinned, so its cell
+ *  stays valid until the cursor moves. the tree shall not be modified
+ *  while a cursor is in use
+ */
+template <typename Key, uint32_t RowSize = DYNAMIC_ROW_SIZE>
+class BasicLeafCursor
+{
+public:
+    // position on cell cell_id of leaf page_id, a position past the end of
+    // the leaf moves forward and a negative one moves backward
+    BasicLeafCursor(BTreePager & pager, uint64_t page_id, int cell_id);
+    ~BasicLeafCursor();
+
+    BasicLeafCursor(BasicLeafCursor && other);
+    BasicLeafCursor(const BasicLeafCursor &) = delete;
+    BasicLeafCursor & operator=(const BasicLeafCursor &) = delete;
+
+    // false once the cursor moved past either end of the tree
+    inline bool is_valid() const { return page_id != PAGE_ID_INVALID; }
+
+    // a byte key points into the pinned leaf as well
+    Key key() const;
+    void * cell() const;
+    void * value() const;
+
+    void next();
+    void prev();
+
+private:
+    // pin leaf page_id instead of the current one
+    void move_to(uint64_t page_id);
+    // skip leaves until cell_id is a cell of the current leaf
+    void settle_forward();
+    void settle_backward();
+
+    BTreePager * pager;
+    uint64_t page_id;
+    void * page;
+    int cell_id;
+};
+
 // class for test
 struct NaryTree;
 /**
@@ -751,21 +1134,125 @@ struct NaryTree;
  * Pager: sync from memory and disk, set and get root id
  * leaf_load and inner_node_load
  * insert()
+ * Key: uint32_t, uint64_t or std::string_view for byte keys, see KeyTraits
+ * RowSize: size of the rows when it is fixed by the schema, leaves then
+ *  address their cells with constants. a file is readable by trees of
+ *  either kind
+ * threads: find, find_row, scan and parallel_scan may run on any number
+ *  of threads while other threads insert or remove. readers validate each
+ *  node against its version latch and restart when it changed, they write
+ *  no shared memory. writers run one at a time and lock only the nodes
+ *  they change. this needs a pager with shared reads (the mmap backend), a
+ *  buffer pool changes its frames on every access and its tree is used by
+ *  one thread at a time. cursors, multi_find and select_cell shall not run
+ *  during a change
  */
-class BPlusTree
+template <typename Key, uint32_t RowSize = DYNAMIC_ROW_SIZE>
+class BasicBPlusTree
 {
 public:
-    BPlusTree(const std::string & path, char mode, uint32_t row_size, uint32_t leaf_node_load = 10, uint32_t inner_node_load = 10);
+    using Traits = KeyTraits<Key>;
+    // a key which is kept by the tree across page accesses
+    using Value = typename Traits::Value;
+    using Node = BasicBtreeNode<Key>;
+    using LeafNode = BasicLeafNode<Key, RowSize>;
+    using InternalNode = BasicInternalNode<Key>;
+    using LeafCursor = BasicLeafCursor<Key, RowSize>;
+
+    // row_size shall be RowSize unless it is DYNAMIC_ROW_SIZE
+    BasicBPlusTree(
+        const std::string & path,
+        char mode,
+        uint32_t row_size,
+        uint32_t leaf_node_load = 10,
+        uint32_t inner_node_load = 10,
+        const PagerOptions & options = PagerOptions(),
+        const WalOptions & wal_options = WalOptions());
+
+    // with a write ahead log the tree is checkpointed at close
+    ~BasicBPlusTree();
 
     uint64_t get_root_page() const;
     uint64_t get_total_page() const;
+    // pages on the free list of the file
+    uint64_t get_num_free_pages() const { return pager.num_free_pages(); }
+    // pages changed in memory but not written yet
+    size_t get_num_dirty_pages() const { return pager.num_dirty_pages(); }
 
     enum class InsertStatus;
-    InsertStatus insert(uint32_t, Row * rows);
-
-    KeyLocation find(uint32_t key);
-
-    std::vector<void *> select_cell(uint32_t min_val, uint32_t max_val);
+    InsertStatus insert(Key key, Row * rows);
+
+    // insert the rows of a batch in key order. rows going to one leaf are
+    // added after one descent, a node which overflows is split into as
+    // many nodes as it needs at once. keys already in the tree and keys
+    // repeated in the batch are skipped, return number of rows inserted
+    using BatchEntry = std::pair<Key, Row *>;
+    size_t insert_batch(std::vector<BatchEntry> batch);
+
+    // a node left less than half loaded borrows a cell from a sibling or
+    // is merged into it, a root with a single child is replaced by it.
+    // pages no longer used go to the free list of the pager
+    enum class RemoveStatus;
+    RemoveStatus remove(Key key);
+
+    // remove every key in [min_key, max_key], return number of keys removed
+    size_t remove_range(Key min_key, Key max_key);
+
+    // produce the next row of a bulk load: set key and row then return
+    // true, return false at the end of the stream
+    using RowSource = std::function<bool(Key & key, Row *& row)>;
+
+    // build the tree bottom-up from rows with strictly increasing keys.
+    // leaves are written one after another, each filled to fill_factor
+    // of its load but at least half, then every inner level is built
+    // from the level below and the root is set once. the tree shall be
+    // empty, it is durable when bulk_load returns
+    void bulk_load(const RowSource & source, double fill_factor = 1.0);
+
+    // make every finished insert durable, inserts are otherwise
+    // synced in groups by the write ahead log. without a log every
+    // dirty page is written and synced
+    void commit();
+
+    KeyLocation find(Key key);
+
+    // copy the row of key into row, false when key is not in the tree
+    bool find_row(Key key, void * row);
+
+    // visit the rows with keys in [min_key, max_key] in key order until
+    // visit returns false, return number of rows visited. the cells of a
+    // leaf are copied before they are visited, a byte key points into the
+    // copy and lives for the call. visit shall not change the tree
+    using RowVisitor = std::function<bool(Key key, const void * row)>;
+    size_t scan(Key min_key, Key max_key, const RowVisitor & visit);
+
+    // scan of [min_key, max_key] by the threads of pool. the range is cut
+    // at the keys of the upper inner levels into morsels, each one is read
+    // like scan by a thread. ordered: the rows are visited in key order one
+    // at a time, on whichever thread delivers them, and morsels read ahead
+    // of the next one wait in memory. otherwise the threads visit the rows
+    // of their morsels at the same time, in key order within a morsel,
+    // worker tells the threads apart for partial aggregates. visit returns
+    // false to stop the scan, return number of rows visited. without
+    // shared reads the calling thread scans alone as worker 0
+    using ParallelRowVisitor = std::function<bool(unsigned worker, Key key, const void * row)>;
+    size_t parallel_scan(Key min_key, Key max_key, WorkStealingPool & pool, bool ordered, const ParallelRowVisitor & visit);
+
+    // locations of many keys, in the order of keys. the tree is walked one
+    // level at a time with the keys sorted: keys reaching the same node share
+    // its search, and the next nodes of a level are prefetched while one is
+    // searched so that their cache misses overlap
+    std::vector<KeyLocation> multi_find(const std::vector<Key> & keys);
+
+    // cursor on the first cell with key >= min_key, one descent then
+    // next() walks the leaf chain
+    LeafCursor seek(Key min_key);
+    // cursor on the last cell with key <= max_key, walk it with prev()
+    LeafCursor seek_reverse(Key max_key);
+
+    // cells point into the buffer pool, they stay valid as long as
+    // the tree fits in the pool. large ranges shall be streamed with seek
+    std::vector<void *> select_cell(Key min_val, Key max_val);
     void print_keys();
 
     // check if the bplus tree has valid structure,
@@ -783,24 +1270,175 @@ public:
         FAIL_DUPLICATE_KEY
     };
 
+    enum class RemoveStatus
+    {
+        SUCCESS,
+        FAIL_KEY_NOT_FOUND
+    };
+
 private:
+    // an inner node passed by a descent and the slot of the child taken
+    struct PathEntry
+    {
+        uint64_t page_id;
+        int slot;
+    };
+    // inner nodes from the root down to the parent of a leaf
+    using DescentPath = std::vector<PathEntry>;
+
+    // find which also records the inner nodes passed when path is not
+    // nullptr, splits and merges walk the path back up
+    KeyLocation find(Key key, DescentPath * path);
+    // a node read by an optimistic reader and its version at that time
+    struct ReadNode
+    {
+        uint64_t page_id;
+        uint64_t version;
+        const void * page;
+    };
+    // descend to the leaf which may hold key without writing shared memory,
+    // false when a node changed on the way and the reader shall restart.
+    // every node passed was validated, the leaf is validated by the caller
+    bool descend_optimistic(Key key, ReadNode & leaf);
+    // page of a reader, nullptr when the page id was read from a node
+    // under change and is no page at all
+    const void * reader_page(uint64_t page_id) { return pager.shared_reads() ? pager.peek_page(page_id) : pager.get_page(page_id); }
+    // the scan of both scan and parallel_scan, visit gets the copy of
+    // each cell in [min_key, max_key]
+    template <typename CellVisitor>
+    size_t scan_cells(Key min_key, Key max_key, CellVisitor && visit);
+    // sorted keys of the upper inner levels inside [min_key, max_key),
+    // levels are added until they cut the range into num_morsels pieces
+    std::vector<Value> morsel_bounds(Key min_key, Key max_key, size_t num_morsels);
+    // a node reached by multi_find and the range [begin, end) of the sorted
+    // keys which reach it
+    struct ProbeRange
+    {
+        uint64_t page_id;
+        uint32_t begin;
+        uint32_t end;
+    };
+    // a key past the last key of the tree is located with the cached path
+    // to the last leaf, other keys by a descent
+    KeyLocation find_for_insert(Key key, DescentPath & path);
     void update_root(uint64_t page_id);
-    void link_to(uint64_t child, uint64_t parent);
-    std::unique_ptr<BtreeNode> get_node_by(uint64_t page_id) { return BtreeNode::LoadNodeFrom(pager.get_page(page_id)); }
+    static std::unique_ptr<Node> load_node(void * page) { return Node::template LoadNodeFrom<RowSize>(page); }
+
+    // record that the page is changed by the current operation, it is
+    // locked for readers from now on
+    void touch(uint64_t page_id);
+    // lock a node for the current operation before it is changed
+    void latch(uint64_t page_id);
+    // unlock the nodes of the current operation, readers which read them
+    // during the operation restart
+    void release_latches();
+    // append the changes of the current operation to the log as one group,
+    // a leaf insert without split is logged as the inserted cell only
+    void log_operation(const void * inserted_cell = nullptr);
+    // redo durable groups of the log then checkpoint
+    void recover();
+    // write all pages to disk then empty the log
+    void checkpoint();
+    // write back a few dirty pages after an operation, drop log groups
+    // which no dirty page needs once the log is large
+    void checkpoint_step();
+    // remove count cells of a leaf then restore the load of the tree,
+    // path leads to the leaf
+    void remove_cells(uint64_t page_id, DescentPath & path, uint32_t cell_num, uint32_t count);
+    // walk up the path from an underloaded node: borrow from or merge with
+    // a sibling until the parent is loaded enough, collapse an empty root
+    void rebalance(uint64_t page_id, DescentPath & path);
+    // return true when node was merged, so that parent lost a key
+    bool rebalance_leaf(InternalNode & parent, uint64_t parent_id, int index, LeafNode & leaf, uint64_t page_id);
+    bool rebalance_inner(InternalNode & parent, uint64_t parent_id, int index, InternalNode & node, uint64_t page_id);
+    // fewest cells of a leaf or keys of an inner node which is not the root:
+    // half of the load, a split leaves that much in each node
+    uint32_t min_leaf_cells(const LeafNode & leaf) const;
+    uint32_t min_inner_keys(const InternalNode & node) const;
+    // put a page of the current operation on the free list
+    void release_page(uint64_t page_id);
+    // a node added by a split of a batch insert and the separator of it
+    // from its left sibling
+    struct SplitEntry
+    {
+        Value key;
+        uint64_t page_id;
+    };
+    // add the rows [begin, end) of a sorted batch to a leaf, return number
+    // of rows added. leaves added on its right go to splits
+    size_t insert_into_leaf(uint64_t page_id, const BatchEntry * begin, const BatchEntry * end, std::vector<SplitEntry> & splits);
+    // add the nodes of splits behind child slot of an inner node, splits
+    // is replaced by the nodes added on the right of the inner node
+    void insert_into_inner(uint64_t page_id, int slot, std::vector<SplitEntry> & splits);
+    // a node of one level and the key range of its subtree
+    struct LevelEntry
+    {
+        uint64_t page_id;
+        Value min_key;
+        Value max_key;
+    };
+    // even out the last two leaves so that neither is less than half loaded
+    void balance_last_leaves(std::vector<LevelEntry> & leaves, uint32_t min_cells);
+    // build the inner nodes above children, return the new level
+    std::vector<LevelEntry> build_inner_level(const std::vector<LevelEntry> & children, uint32_t num_keys, uint32_t min_keys);
+    // lsn of the group the current operation will be logged with
+    inline uint64_t operation_lsn() const { return wal == nullptr ? 0 : wal->next_lsn(); }
+    // visit the subtree of keys in [min_key, max_key], a missing bound
+    // leaves the range open on its side
     void post_order_visit(
         uint64_t page_id,
-        std::function<void(uint64_t)> inner_node_action,
-        std::function<void(uint64_t)> leaf_node_action,
-        std::function<void(void *)> leaf_cell_action,
-        uint32_t min_key,
-        uint32_t max_key);
+        const std::function<void(uint64_t)> & inner_node_action,
+        const std::function<void(uint64_t)> & leaf_node_action,
+        const std::function<void(void *)> & leaf_cell_action,
+        std::optional<Key> min_key,
+        std::optional<Key> max_key);
     // check valid
 
     BTreePager pager;
+    // nullptr when the log is disabled, destroyed before the pager
+    std::unique_ptr<WriteAheadLog> wal;
+    // pages changed by the current operation, pinned until it is logged
+    std::vector<uint64_t> touched_pages;
+    // touched pages which were put on the free list
+    std::vector<uint64_t> freed_pages;
+    // version latches of the nodes and the nodes locked by the current operation
+    NodeLatches latches;
+    std::vector<uint64_t> latched_pages;
+    // root for readers, it changes while the old root is locked
+    std::atomic<uint64_t> root_id;
+    // taken by the operations which change the tree
+    std::mutex writer_mutex;
+    // cells of the leaves for readers
+    const LeafCellLayout<Key, RowSize> leaf_cells;
+    bool root_changed;
+    // lsn of the group which set the root, meta data waits for it
+    uint64_t meta_lsn;
     uint32_t leaf_load;
     uint32_t inner_node_load;
     void * root_page;
-    std::unique_ptr<BtreeNode> root;
+    std::unique_ptr<Node> root;
+    // last leaf and the path to it as left by the latest append, set to
+    // PAGE_ID_INVALID by any other change of the structure of the tree
+    uint64_t last_leaf;
+    DescentPath last_leaf_path;
 
     friend struct NaryTree;
-};
\ No newline at end of file
+};
+
+// trees of the table, keyed by the 4 byte id of a row
+using BtreeNode = BasicBtreeNode<uint32_t>;
+using LeafNode = BasicLeafNode<uint32_t>;
+using InternalNode = BasicInternalNode<uint32_t>;
+using LeafCursor = BasicLeafCursor<uint32_t>;
+using BPlusTree = BasicBPlusTree<uint32_t>;
+// tree of UserInfo rows, whose size is fixed
+using UserInfoBPlusTree = BasicBPlusTree<uint32_t, UserInfo::ROW_BYTE>;
+
+extern template class BasicLeafCursor<uint32_t>;
+extern template class BasicLeafCursor<uint32_t, UserInfo::ROW_BYTE>;
+extern template class BasicLeafCursor<uint64_t>;
+extern template class BasicLeafCursor<std::string_view>;
+extern template class BasicBPlusTree<uint32_t>;
+extern template class BasicBPlusTree<uint32_t, UserInfo::ROW_BYTE>;
+extern template class BasicBPlusTree<uint64_t>;
+extern template class BasicBPlusTree<std::string_view>;
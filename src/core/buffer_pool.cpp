@@ -0,0 +1,309 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void * allocate_page_frame()
+{
+    void * frame = nullptr;
+    if (posix_memalign(&frame, PAGE_SIZE, PAGE_SIZE) != 0)
+    {
+        perror("allocate page frame error");
+        exit(EXIT_FAILURE);
+    }
+    return frame;
+}
+
+void free_page_frame(void * frame)
+{
+    free(frame);
+}
+
+BufferPool::BufferPool(size_t capacity, PageReader reader, PageWriter writer, HugePages huge_pages)
+    : max_frames(capacity), arena(capacity, huge_pages), read_page(std::move(reader)), write_page(std::move(writer)),
+      clock_hand(0), flush_cursor(0)
+{
+    // frames are bound to pages on demand, the arena reserved their memory
+    frames.reserve(max_frames);
+}
+
+BufferPool::~BufferPool()
+{
+    // frames are released with the arena
+    flush_all();
+}
+
+void * BufferPool::fetch(uint64_t page_id)
+{
+    auto it = page_table.find(page_id);
+    if (it != page_table.end())
+    {
+        Frame & frame = frames[it->second];
+        frame.referenced = true;
+        return frame.data;
+    }
+
+    // page fault: load page into a new frame
+    size_t fid = allocate_frame(page_id);
+    read_page(page_id, frames[fid].data);
+    return frames[fid].data;
+}
+
+void * BufferPool::create(uint64_t page_id)
+{
+    assert(!is_resident(page_id));
+
+    size_t fid = allocate_frame(page_id);
+    memset(frames[fid].data, 0, PAGE_SIZE);
+    frames[fid].dirty = true;
+    dirty_pages[page_id] = DirtyPage{0, 0};
+    return frames[fid].data;
+}
+
+void BufferPool::pin(uint64_t page_id)
+{
+    resident_frame(page_id).pin_count += 1;
+}
+
+void BufferPool::unpin(uint64_t page_id)
+{
+    Frame & frame = resident_frame(page_id);
+    assert(frame.pin_count > 0);
+    frame.pin_count -= 1;
+}
+
+void BufferPool::mark_dirty(uint64_t page_id, uint64_t lsn)
+{
+    resident_frame(page_id).dirty = true;
+
+    auto & entry = dirty_pages[page_id];
+    if (entry.rec_lsn == 0)
+        entry.rec_lsn = lsn;
+    entry.page_lsn = std::max(entry.page_lsn, lsn);
+}
+
+void BufferPool::flush(uint64_t page_id)
+{
+    auto it = page_table.find(page_id);
+    if (it == page_table.end())
+        return;
+
+    Frame & frame = frames[it->second];
+    if (frame.dirty)
+    {
+        write_page(page_id, frame.data);
+        set_clean(frame);
+    }
+}
+
+void BufferPool::evict(uint64_t page_id)
+{
+    auto it = page_table.find(page_id);
+    if (it == page_table.end())
+        return;
+
+    size_t fid = it->second;
+    if (frames[fid].pin_count > 0)
+    {
+        fprintf(stderr, "can not evict pinned page %llu\n", (unsigned long long)page_id);
+        exit(EXIT_FAILURE);
+    }
+
+    flush(page_id);
+    page_table.erase(it);
+    free_frames.push_back(fid);
+}
+
+void BufferPool::flush_all()
+{
+    // dirty pages are already in file order
+    PageBatch pages;
+    for (auto & entry : dirty_pages)
+        pages.push_back({entry.first, frames[page_table[entry.first]].data});
+
+    write_back(pages);
+}
+
+size_t BufferPool::flush_some(size_t max_pages, uint64_t durable_lsn)
+{
+    if (dirty_pages.empty() || max_pages == 0)
+        return 0;
+
+    // sweep the dirty pages from the cursor and wrap around at the end
+    PageBatch pages;
+    auto it = dirty_pages.lower_bound(flush_cursor);
+    bool wrapped = false;
+    while (pages.size() < max_pages)
+    {
+        if (it == dirty_pages.end())
+        {
+            if (wrapped)
+                break;
+            it = dirty_pages.begin();
+            wrapped = true;
+        }
+
+        if (wrapped && it->first >= flush_cursor)
+            break;
+
+        if (it->second.page_lsn < durable_lsn)
+            pages.push_back({it->first, frames[page_table[it->first]].data});
+        ++it;
+    }
+
+    if (pages.empty())
+        return 0;
+
+    flush_cursor = pages.back().first + 1;
+    std::sort(pages.begin(), pages.end());
+    write_back(pages);
+    return pages.size();
+}
+
+uint64_t BufferPool::oldest_dirty_lsn() const
+{
+    uint64_t oldest = UINT64_MAX;
+    for (auto & entry : dirty_pages)
+        if (entry.second.rec_lsn != 0)
+            oldest = std::min(oldest, entry.second.rec_lsn);
+    return oldest;
+}
+
+void BufferPool::write_back(const PageBatch & pages)
+{
+    if (pages.empty())
+        return;
+
+    if (write_batch != nullptr)
+        write_batch(pages);
+    else
+        for (auto & page : pages)
+            write_page(page.first, page.second);
+
+    for (auto & page : pages)
+        set_clean(frames[page_table[page.first]]);
+}
+
+void BufferPool::set_clean(Frame & frame)
+{
+    frame.dirty = false;
+    dirty_pages.erase(frame.page_id);
+}
+
+void BufferPool::prefetch(const std::vector<uint64_t> & page_ids)
+{
+    if (read_batch == nullptr)
+        return;
+
+    std::vector<uint64_t> missing;
+    size_t limit = std::max<size_t>(max_frames / 4, 1);
+    for (auto page_id : page_ids)
+    {
+        if (missing.size() == limit)
+            break;
+        if (!is_resident(page_id) && std::find(missing.begin(), missing.end(), page_id) == missing.end())
+            missing.push_back(page_id);
+    }
+
+    if (missing.empty())
+        return;
+
+    // frames of the batch are pinned so that loading one page can not
+    // evict another page of the same batch
+    std::sort(missing.begin(), missing.end());
+    PageBatch pages;
+    for (auto page_id : missing)
+    {
+        size_t fid = allocate_frame(page_id);
+        frames[fid].pin_count += 1;
+        pages.push_back({page_id, frames[fid].data});
+    }
+
+    read_batch(pages);
+
+    for (auto page_id : missing)
+        frames[page_table[page_id]].pin_count -= 1;
+}
+
+void BufferPool::set_batch_io(PageBatchIO reader, PageBatchIO writer)
+{
+    read_batch = std::move(reader);
+    write_batch = std::move(writer);
+}
+
+size_t BufferPool::allocate_frame(uint64_t page_id)
+{
+    size_t fid;
+    if (!free_frames.empty())
+    {
+        fid = free_frames.back();
+        free_frames.pop_back();
+    }
+    else if (frames.size() < max_frames)
+    {
+        void * data = arena.allocate();
+        frames.push_back(Frame{data, 0, 0, false, false});
+        fid = frames.size() - 1;
+    }
+    // pool is full: write back the victim and reuse its frame
+    else
+    {
+        fid = find_victim();
+        Frame & victim = frames[fid];
+        if (victim.dirty)
+        {
+            write_page(victim.page_id, victim.data);
+            set_clean(victim);
+        }
+        page_table.erase(victim.page_id);
+    }
+
+    Frame & frame = frames[fid];
+    frame.page_id = page_id;
+    frame.pin_count = 0;
+    frame.dirty = false;
+    frame.referenced = true;
+    page_table[page_id] = fid;
+
+    return fid;
+}
+
+size_t BufferPool::find_victim()
+{
+    // the first sweep clears reference bits, the second one must find
+    // a victim unless every frame is pinned
+    for (size_t step = 0; step < 2 * frames.size(); ++step)
+    {
+        size_t fid = clock_hand;
+        clock_hand = (clock_hand + 1) % frames.size();
+
+        Frame & frame = frames[fid];
+        if (frame.pin_count > 0)
+            continue;
+
+        if (frame.referenced)
+        {
+            frame.referenced = false;
+            continue;
+        }
+
+        return fid;
+    }
+
+    fprintf(stderr, "buffer pool exhausted: all %zu frames are pinned\n", frames.size());
+    exit(EXIT_FAILURE);
+}
+
+BufferPool::Frame & BufferPool::resident_frame(uint64_t page_id)
+{
+    auto it = page_table.find(page_id);
+    if (it == page_table.end())
+    {
+        fprintf(stderr, "page %llu is not resident\n", (unsigned long long)page_id);
+        exit(EXIT_FAILURE);
+    }
+
+    return frames[it->second];
+}
@@ -0,0 +1,173 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "page_arena.h"
+#include "parameters.h"
+
+// memory for one page aligned to PAGE_SIZE so that it can be used for
+// direct io, exit on failure. frames of a cache come from its PageArena
+void * allocate_page_frame();
+void free_page_frame(void * frame);
+
+/**
+ * @brief memory that holds pages of a BTreePager
+ *  a page returned by fetch or create stays valid while it is pinned
+ */
+class PageCache
+{
+public:
+    virtual ~PageCache(){};
+
+    // get memory of a page, load it from disk when it is not resident
+    virtual void * fetch(uint64_t page_id) = 0;
+
+    // get zero filled memory for a page which does not exist on disk
+    // the new page is dirty
+    virtual void * create(uint64_t page_id) = 0;
+
+    virtual void pin(uint64_t page_id) = 0;
+    virtual void unpin(uint64_t page_id) = 0;
+
+    // lsn: log group needed to redo the change, 0 when it is not logged.
+    // a dirty page remembers the lsn of its first change (rec_lsn) and of
+    // its last change (page_lsn) until it is written back
+    virtual void mark_dirty(uint64_t page_id, uint64_t lsn = 0) = 0;
+
+    // write page back to disk if it is dirty, page stays resident
+    virtual void flush(uint64_t page_id) = 0;
+
+    // write page back to disk if it is dirty then release its memory
+    virtual void evict(uint64_t page_id) = 0;
+
+    // write all dirty pages back to disk
+    virtual void flush_all() = 0;
+
+    // write at most max_pages dirty pages in page id order, each call
+    // continues after the last page written by the previous one. pages
+    // with page_lsn >= durable_lsn are skipped since writing them would
+    // force a sync of the log
+    virtual size_t flush_some(size_t /*max_pages*/, uint64_t /*durable_lsn*/ = UINT64_MAX) { return 0; }
+
+    // smallest rec_lsn of the dirty pages, UINT64_MAX when there is none
+    virtual uint64_t oldest_dirty_lsn() const { return UINT64_MAX; }
+
+    virtual size_t num_dirty() const { return 0; }
+
+    // hint that the pages will be fetched soon, page_ids are sorted
+    virtual void prefetch(const std::vector<uint64_t> & /*page_ids*/) { }
+
+    // whether fetching the page needs no io of the cache
+    virtual bool is_resident(uint64_t /*page_id*/) const { return true; }
+
+    // page for a thread which reads while another thread changes the
+    // cache, nullptr when page_id is not a page of the cache. a cache whose
+    // fetch changes its own state, like a buffer pool, has no such reads
+    virtual const void * peek(uint64_t /*page_id*/) const { return nullptr; }
+
+    virtual size_t capacity() const = 0;
+    virtual size_t num_resident() const = 0;
+
+    // bytes of memory owned by the cache
+    virtual size_t memory_bytes() const { return 0; }
+};
+
+/**
+ * @brief fixed number of page frames shared by all pages of a file
+ *  pages are loaded on demand and evicted with CLOCK replacement
+ *  when every frame is occupied. a pinned page is never evicted and
+ *  a dirty page is written back before its frame is reused
+ */
+class BufferPool : public PageCache
+{
+public:
+    // callbacks to move a page between disk and a frame
+    using PageReader = std::function<void(uint64_t page_id, void * frame)>;
+    using PageWriter = std::function<void(uint64_t page_id, const void * frame)>;
+
+    // callback to move many pages at once, pages are sorted by page id
+    using PageBatch = std::vector<std::pair<uint64_t, void *>>;
+    using PageBatchIO = std::function<void(const PageBatch & pages)>;
+
+    // frames are taken from one arena of capacity frames
+    BufferPool(size_t capacity, PageReader reader, PageWriter writer, HugePages huge_pages = HugePages::NONE);
+    virtual ~BufferPool() override;
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool & operator=(const BufferPool &) = delete;
+
+    virtual void * fetch(uint64_t page_id) override;
+    virtual void * create(uint64_t page_id) override;
+    virtual void pin(uint64_t page_id) override;
+    virtual void unpin(uint64_t page_id) override;
+    virtual void mark_dirty(uint64_t page_id, uint64_t lsn = 0) override;
+    virtual void flush(uint64_t page_id) override;
+    virtual void evict(uint64_t page_id) override;
+
+    // cost is bounded by the number of dirty pages, not resident ones
+    virtual void flush_all() override;
+    virtual size_t flush_some(size_t max_pages, uint64_t durable_lsn = UINT64_MAX) override;
+    virtual uint64_t oldest_dirty_lsn() const override;
+    virtual size_t num_dirty() const override { return dirty_pages.size(); }
+
+    // load missing pages with one batch read, at most a quarter of the
+    // pool is filled by one call so that the working set survives
+    virtual void prefetch(const std::vector<uint64_t> & page_ids) override;
+
+    // when set, flush_all and prefetch issue batches instead of page by page io
+    void set_batch_io(PageBatchIO reader, PageBatchIO writer);
+
+    virtual bool is_resident(uint64_t page_id) const override { return page_table.count(page_id) > 0; }
+    virtual size_t capacity() const override { return max_frames; }
+    virtual size_t num_resident() const override { return page_table.size(); }
+    virtual size_t memory_bytes() const override { return arena.reserved_bytes(); }
+    inline HugePages huge_pages() const { return arena.huge_pages(); }
+
+private:
+    struct Frame
+    {
+        void * data;
+        uint64_t page_id;
+        uint32_t pin_count;
+        bool dirty;
+        bool referenced; // reference bit of CLOCK
+    };
+
+    // bind a frame to page_id, evict an old page when pool is full
+    size_t allocate_frame(uint64_t page_id);
+
+    // index of the next unpinned frame whose reference bit is clear
+    size_t find_victim();
+
+    Frame & resident_frame(uint64_t page_id);
+
+    // write pages sorted by page id then mark them clean
+    void write_back(const PageBatch & pages);
+    void set_clean(Frame & frame);
+
+    const size_t max_frames;
+    PageArena arena;
+    PageReader read_page;
+    PageWriter write_page;
+    PageBatchIO read_batch;
+    PageBatchIO write_batch;
+
+    std::vector<Frame> frames;
+    std::vector<size_t> free_frames;
+    std::unordered_map<uint64_t, size_t> page_table;
+    size_t clock_hand;
+
+    struct DirtyPage
+    {
+        uint64_t rec_lsn;
+        uint64_t page_lsn;
+    };
+
+    // dirty page table ordered by page id for flush_some
+    std::map<uint64_t, DirtyPage> dirty_pages;
+    uint64_t flush_cursor;
+};
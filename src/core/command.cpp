@@ -36,14 +36,17 @@ ExecuteResult * SelectUsingBtree::evaluate()
 {
     auto & handler = GlobalVariableHandler::get_instance();
     auto & btree = handler.get_btree();
-    auto results = btree.select_cell(0, UINT32_MAX);
-    if (results.size() == 0)
+
+    // rows are printed while the cursor walks the leaves, only the leaf
+    // under the cursor is pinned
+    auto cursor = btree.seek(0);
+    if (!cursor.is_valid())
         std::cout << "no entries found" << endl;
 
     UserInfo row;
-    for(void * cell: results)
+    for (; cursor.is_valid(); cursor.next())
     {
-        row.deserialize(LeafNode::extract_value(cell));
+        row.deserialize(cursor.value());
         std::cout << row.to_string() << std::endl;
     }
 
@@ -81,10 +84,13 @@ ExecuteResult * InsertToBtree::evaluate() {
 
     auto status = btree.insert(row_to_insert->get_primary_key(), row_to_insert);
 
-    if (status == BPlusTree::InsertStatus::SUCCESS)
+    // the statement is reported after its log record is durable
+    if (status == UserInfoBPlusTree::InsertStatus::SUCCESS) {
+        btree.commit();
         return new ExecuteResult(ExecuteStatus::EXECUTE_SUCCESS);
-    else if (status == BPlusTree::InsertStatus::FAIL_DUPLICATE_KEY)
+    } else if (status == UserInfoBPlusTree::InsertStatus::FAIL_DUPLICATE_KEY) {
         return new ExecuteResult(ExecuteStatus::DUPLICATE_KEY);
+    }
 
     return new ExecuteResult(ExecuteStatus::EXECUTE_FAIL);
 }
@@ -1,13 +1,16 @@
 #include "dbfile.h"
+#include <algorithm>
 #include <cassert>
+#include <cerrno>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <unistd.h>
 #include "parameters.h"
 
-DbFile::DbFile(const std::string & path) : file_path(path)
+DbFile::DbFile(const std::string & path) : file_path(path), arena(TABLE_MAX_PAGES)
 {
     // open file descriptor
     file_descriptor = open(path.c_str(), O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
@@ -53,24 +56,16 @@ void * DbFile::get_page(int page_id)
     if (pages[page_id] != nullptr)
         return pages[page_id];
 
-    // malloc a page: shall remove when flush
-    void * page = malloc(PAGE_SIZE);
+    // take a frame: returned when flush
+    void * page = arena.allocate();
     size_t payload_bytes = 0;
 
     // fill contents in page
     if (page_id < num_pages)
     {
-        off_t page_start = page_id * PAGE_SIZE;
-        off_t status = lseek(file_descriptor, page_start, SEEK_SET);
-        if (status < 0)
-        {
-            perror("lseek error");
-            exit(EXIT_FAILURE);
-        }
-        assert(status == page_start);
-
         // read from page_start to the end
-        auto nbytes = read_buffer(file_descriptor, page, PAGE_SIZE);
+        off_t page_start = (off_t)page_id * PAGE_SIZE;
+        auto nbytes = read_buffer_at(file_descriptor, page, PAGE_SIZE, page_start);
 
         assert(nbytes >= 0);
         payload_bytes = nbytes;
@@ -85,22 +80,13 @@ void DbFile::flush_page(int page_id, size_t size)
     if (pages[page_id] == nullptr)
         return;
 
-    // seek to write position
-    off_t page_start = page_id * PAGE_SIZE;
-    off_t status = lseek(file_descriptor, page_start, SEEK_SET);
-    if (status < 0)
-    {
-        perror("lseek error");
-        exit(EXIT_FAILURE);
-    }
-    assert(status == page_start);
-
     // write data to disk
-    auto nbytes = write_buffer(file_descriptor, pages[page_id], size);
+    off_t page_start = (off_t)page_id * PAGE_SIZE;
+    auto nbytes = write_buffer_at(file_descriptor, pages[page_id], size, page_start);
     assert(nbytes >= 0);
 
     // free memeory
-    free(pages[page_id]);
+    arena.release(pages[page_id]);
     pages[page_id] = nullptr;
 }
 
@@ -161,151 +147,477 @@ ssize_t write_buffer(int fd, void * src, size_t buffer_size)
     return nwrite;
 }
 
-void BtreeMetaData::write_to_disk()
+ssize_t read_buffer_at(int fd, void * dst, size_t buffer_size, off_t offset)
+{
+    ssize_t nread = 0;
+    while (buffer_size > 0)
+    {
+        ssize_t nbyte = pread(fd, dst, buffer_size, offset);
+        if (nbyte == 0)
+            return nread;
+
+        // error meet
+        if (nbyte < 0)
+        {
+            perror("pread buffer error");
+            exit(EXIT_FAILURE);
+            return nbyte;
+        }
+
+        nread += nbyte;
+        buffer_size -= nbyte;
+        offset += nbyte;
+        dst = (char *)dst + nbyte;
+    }
+
+    return nread;
+}
+
+ssize_t write_buffer_at(int fd, const void * src, size_t buffer_size, off_t offset)
 {
-    // meta data is located at the front page
-    off_t status = lseek(file_descriptor, 0, SEEK_SET);
-    assert(status == 0);
+    ssize_t nwrite = 0;
+
+    while (buffer_size > 0)
+    {
+        ssize_t nbyte = pwrite(fd, src, buffer_size, offset);
+
+        if (nbyte == -1)
+        {
+            perror("pwrite buffer error");
+            exit(EXIT_FAILURE);
+            return -1;
+        }
+
+        nwrite += nbyte;
+        buffer_size -= nbyte;
+        offset += nbyte;
+        src = (const char *)src + nbyte;
+    }
 
-    write_buffer(file_descriptor, &root_pid, sizeof(uint64_t));
-    write_buffer(file_descriptor, &num_pages, sizeof(uint64_t));
+    return nwrite;
+}
+
+void sync_file_data(int fd)
+{
+#ifdef __linux__
+    int status = fdatasync(fd);
+#else
+    int status = fsync(fd);
+#endif
+    if (status < 0)
+    {
+        perror("sync file error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void BtreeMetaData::write_to_disk()
+{
+    // the whole header page is written from an aligned buffer, as
+    // required by direct io
+    uint64_t * buffer = (uint64_t *)allocate_page_frame();
+    memset(buffer, 0, PAGE_SIZE);
+    buffer[0] = MAGIC;
+    buffer[1] = root_pid;
+    buffer[2] = num_pages;
+    buffer[3] = free_head;
+    buffer[4] = num_free;
+
+    auto nbytes = write_buffer_at(file_descriptor, buffer, PAGE_SIZE, 0);
+    assert(nbytes == PAGE_SIZE);
+    free_page_frame(buffer);
 }
 
 void BtreeMetaData::load_from_disk()
 {
-    // meta data is located at the front page
-    off_t status = lseek(file_descriptor, 0, SEEK_SET);
-    assert(status == 0);
+    uint64_t * buffer = (uint64_t *)allocate_page_frame();
+    auto nbytes = read_buffer_at(file_descriptor, buffer, PAGE_SIZE, 0);
+    if (nbytes < get_data_size() || buffer[0] != MAGIC)
+    {
+        fprintf(stderr, "%s is not a b+tree file\n", file_path.c_str());
+        exit(EXIT_FAILURE);
+    }
 
-    read_buffer(file_descriptor, &root_pid, sizeof(uint64_t));
-    read_buffer(file_descriptor, &num_pages, sizeof(uint64_t));
+    root_pid = buffer[1];
+    num_pages = buffer[2];
+    free_head = buffer[3];
+    num_free = buffer[4];
+    free_page_frame(buffer);
 }
 
 
-BTreePager::BTreePager(const std::string & path, char mode)
+BTreePager::BTreePager(const std::string & path, char mode, const PagerOptions & options)
+    : checkpoint_step_pages(options.checkpoint_step_pages), checkpoint_dirty_pages(options.checkpoint_dirty_pages),
+      direct_io(false), mmap_backend(options.backend == PagerBackend::MMAP), readahead_pages(options.readahead_pages),
+      last_miss(PAGE_ID_INVALID), sequential_misses(0), readahead_next(0), readahead_window(0)
 {
-    int fd = -1;
+    int flags = O_RDWR;
     if (mode == 'c')
     {
-        fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+        flags |= O_CREAT | O_TRUNC;
     }
-    else if (mode == 'o')
+    else if (mode != 'o')
     {
-        fd = open(path.c_str(), O_RDWR, S_IWUSR | S_IRUSR);
+        fprintf(stderr, "mode shall be 'o' or 'c'");
+        exit(EXIT_FAILURE);
     }
-    else
+
+    if (options.direct_io && options.backend == PagerBackend::MMAP)
     {
-        fprintf(stderr, "mode shall be 'o' or 'c'");
+        fprintf(stderr, "direct io requires the buffer pool backend\n");
         exit(EXIT_FAILURE);
     }
 
+    int fd = -1;
+#ifdef O_DIRECT
+    if (options.direct_io)
+    {
+        fd = open(path.c_str(), flags | O_DIRECT, S_IWUSR | S_IRUSR);
+        direct_io = fd >= 0;
+        if (fd < 0 && errno != EINVAL)
+        {
+            perror("open file error");
+            exit(EXIT_FAILURE);
+        }
+    }
+#endif
+
+    if (fd < 0)
+        fd = open(path.c_str(), flags, S_IWUSR | S_IRUSR);
+
     if (fd < 0)
     {
         perror("open file error");
         exit(EXIT_FAILURE);
     }
 
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+    // macos: no O_DIRECT, but the file can skip the unified buffer cache
+    if (options.direct_io)
+        direct_io = fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+
     // load meta data
     metaData = new BtreeMetaData(path, fd);
     if (mode == 'o')
         metaData->load_from_disk();
+    else
+        metaData->write_to_disk();
 
-    for (int i = 0; i < TABLE_MAX_PAGES; ++i)
-        pages[i] = nullptr;
-
-    // std::cout << "here out of constructor" << std::endl;
+    if (options.backend == PagerBackend::MMAP)
+    {
+        page_cache = new MmapPageCache(fd, BtreeMetaData::page_offset(0), metaData->num_pages, options.mmap_max_pages);
+    }
+    else
+    {
+        auto pool = new BufferPool(
+            options.pool_pages,
+            [this](uint64_t page_id, void * page) { read_page(page_id, page); },
+            [this](uint64_t page_id, const void * page) { write_page(page_id, page); },
+            options.huge_pages);
+
+        if (options.io_engine == IoEngine::ASYNC)
+            async_io = AsyncPageIO::create(fd, options.io_queue_depth, options.io_threads);
+        else if (options.io_engine == IoEngine::THREAD_POOL)
+            async_io = std::make_unique<ThreadPoolPageIO>(fd, options.io_threads);
+
+        // shutdown flushes and prefetches keep the device queue full
+        if (async_io != nullptr)
+        {
+            pool->set_batch_io(
+                [this](const BufferPool::PageBatch & pages) { run_batch(pages, PageRequest::Type::READ); },
+                [this](const BufferPool::PageBatch & pages) { run_batch(pages, PageRequest::Type::WRITE); });
+        }
+        page_cache = pool;
+    }
 }
 
 BTreePager::~BTreePager()
 {
-    // flush?
-    metaData->write_to_disk();
-    for (int i = 0; i < metaData->num_pages; ++i)
-        flush_page(i);
+    // only dirty pages are written back
+    write_metadata();
+    page_cache->flush_all();
+    delete page_cache;
+    async_io.reset();
 
     close(metaData->file_descriptor);
     delete metaData;
 }
 
-void * BTreePager::get_page(int page_id)
+void BTreePager::check_page_id(int64_t page_id) const
 {
-    // error: page_id > num_page
     auto num_pages = metaData->num_pages;
-    if (page_id >= num_pages)
+    if (page_id < 0 || (uint64_t)page_id >= num_pages)
     {
-        fprintf(stderr, "page_id %d greater than capacity %lld\n", page_id, num_pages);
+        fprintf(stderr, "page_id %lld out of range [0, %llu)\n", (long long)page_id, (unsigned long long)num_pages);
         exit(EXIT_FAILURE);
-        return nullptr;
     }
+}
 
-    // when page is already in memory
-    if (pages[page_id] != nullptr)
-        return pages[page_id];
+void * BTreePager::get_page(int page_id)
+{
+    // error: page_id > num_page
+    check_page_id(page_id);
+    on_access(page_id);
+    return page_cache->fetch(page_id);
+}
+
+void * BTreePager::pin_page(uint64_t page_id)
+{
+    check_page_id(page_id);
+    on_access(page_id);
+    void * page = page_cache->fetch(page_id);
+    page_cache->pin(page_id);
+    return page;
+}
 
-    // malloc a page: shall remove when flush
-    void * page = malloc(PAGE_SIZE);
+void BTreePager::unpin_page(uint64_t page_id)
+{
+    page_cache->unpin(page_id);
+}
 
-    // load data from disk
-    off_t page_start = metaData->get_data_size() + page_id * PAGE_SIZE;
-    off_t status = lseek(metaData->file_descriptor, page_start, SEEK_SET);
-    if (status < 0)
+void BTreePager::mark_dirty(uint64_t page_id, uint64_t lsn)
+{
+    page_cache->mark_dirty(page_id, lsn);
+}
+
+size_t BTreePager::checkpoint_step(uint64_t durable_lsn)
+{
+    if (page_cache->num_dirty() <= checkpoint_dirty_pages)
+        return 0;
+    return page_cache->flush_some(checkpoint_step_pages, durable_lsn);
+}
+
+void BTreePager::prefetch(const std::vector<uint64_t> & page_ids)
+{
+    if (readahead_pages == 0)
+        return;
+
+    std::vector<uint64_t> missing;
+    for (auto page_id : page_ids)
+        if (page_id < metaData->num_pages && !page_cache->is_resident(page_id))
+            missing.push_back(page_id);
+
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    read_ahead(missing);
+}
+
+// windows of a readahead stream grow from this size
+const size_t READAHEAD_MIN_PAGES = 4;
+// consecutive misses which open a stream
+const size_t READAHEAD_TRIGGER = 3;
+
+void BTreePager::on_access(uint64_t page_id)
+{
+    // the kernel reads ahead of sequential buffered reads and page faults
+    // by itself, a second stream would only duplicate its io. direct reads
+    // of the sync engine can not run ahead of the reader
+    if (readahead_pages == 0 || async_io == nullptr)
+        return;
+
+    // within the stream: once the reader passed half of the window
+    // the next window is requested
+    bool in_stream = readahead_next > 0 && page_id <= readahead_next && page_id + readahead_window >= readahead_next;
+    if (!in_stream)
     {
-        fprintf(stderr, "lseek error\n");
-        exit(EXIT_FAILURE);
+        if (page_cache->is_resident(page_id))
+            return;
+
+        sequential_misses = page_id == last_miss + 1 ? sequential_misses + 1 : 1;
+        last_miss = page_id;
+        if (sequential_misses < READAHEAD_TRIGGER)
+            return;
+
+        readahead_next = page_id + 1;
+        readahead_window = std::min(READAHEAD_MIN_PAGES, readahead_pages);
+    }
+    else if (page_id + readahead_window / 2 < readahead_next)
+    {
+        return;
     }
-    assert(status == page_start);
-    auto nbytes = read_buffer(metaData->file_descriptor, page, PAGE_SIZE);
-    assert(nbytes == PAGE_SIZE);
 
-    // push page into cache
-    pages[page_id] = page;
+    uint64_t end = std::min<uint64_t>(readahead_next + readahead_window, metaData->num_pages);
+    std::vector<uint64_t> window;
+    for (uint64_t pid = readahead_next; pid < end; ++pid)
+        if (!page_cache->is_resident(pid))
+            window.push_back(pid);
 
-    return page;
+    read_ahead(window);
+    readahead_next = std::max(end, readahead_next);
+    readahead_window = std::min(readahead_window * 2, readahead_pages);
+}
+
+void BTreePager::read_ahead(const std::vector<uint64_t> & page_ids)
+{
+    if (page_ids.empty())
+        return;
+
+    // pages are loaded into the pool by the engine or advised to the kernel
+    if (async_io != nullptr || mmap_backend)
+    {
+        page_cache->prefetch(page_ids);
+        return;
+    }
+
+    // the kernel cache is bypassed, a hint would be useless
+    if (direct_io)
+        return;
+
+    // pages which are mostly consecutive are read ahead by the kernel, a
+    // hint would take them out of its sequential readahead
+    if (page_ids.back() - page_ids.front() < 2 * page_ids.size())
+        return;
+
+#ifdef POSIX_FADV_WILLNEED
+    size_t i = 0;
+    while (i < page_ids.size())
+    {
+        size_t j = i + 1;
+        while (j < page_ids.size() && page_ids[j] == page_ids[j - 1] + 1)
+            j += 1;
+
+        off_t length = (off_t)(j - i) * PAGE_SIZE;
+        posix_fadvise(metaData->file_descriptor, BtreeMetaData::page_offset(page_ids[i]), length, POSIX_FADV_WILLNEED);
+        i = j;
+    }
+#endif
 }
 
 uint64_t BTreePager::allocate_page(void *& new_page)
 {
-    // allocate memory
-    void * page = malloc(PAGE_SIZE);
+    // meta data changes in memory only, it reaches disk at the next
+    // commit or checkpoint
+    uint64_t page_id = metaData->free_head;
+    if (page_id != PAGE_ID_INVALID)
+    {
+        new_page = page_cache->fetch(page_id);
+        metaData->free_head = *(uint64_t *)new_page;
+        metaData->num_free -= 1;
+
+        memset(new_page, 0, PAGE_SIZE);
+        page_cache->mark_dirty(page_id);
+        return page_id;
+    }
 
-    // change meta data
+    // the frame of a new page is dirty, it reaches disk at eviction or close
+    page_id = metaData->num_pages;
     metaData->num_pages += 1;
-    pages[metaData->num_pages - 1] = page;
+    new_page = page_cache->create(page_id);
 
-    // write back meta data
+    return page_id;
+}
+
+void BTreePager::free_page(uint64_t page_id)
+{
+    check_page_id(page_id);
+    void * page = page_cache->fetch(page_id);
+    *(uint64_t *)page = metaData->free_head;
+    page_cache->mark_dirty(page_id);
+
+    metaData->free_head = page_id;
+    metaData->num_free += 1;
+}
+
+void BTreePager::set_write_barrier(WriteBarrier barrier)
+{
+    write_barrier = std::move(barrier);
+}
+
+void BTreePager::extend_to(uint64_t num_pages)
+{
+    if (num_pages > metaData->num_pages)
+        metaData->num_pages = num_pages;
+}
+
+void BTreePager::restore_free_list(uint64_t free_head, uint64_t num_free)
+{
+    metaData->free_head = free_head;
+    metaData->num_free = num_free;
+}
+
+void BTreePager::sync_to_disk()
+{
+    page_cache->flush_all();
+    sync_metadata();
+}
+
+void BTreePager::sync_metadata()
+{
+    write_metadata();
+    sync_file_data(metaData->file_descriptor);
+}
+
+void BTreePager::write_metadata()
+{
+    if (write_barrier != nullptr)
+        write_barrier(nullptr);
     metaData->write_to_disk();
-    // sync to disk?
+}
 
-    new_page = page;
-    return metaData->num_pages - 1;
+void BTreePager::read_page(uint64_t page_id, void * page)
+{
+    // load data from disk, one syscall and no shared file offset
+    off_t page_start = BtreeMetaData::page_offset(page_id);
+    auto nbytes = read_buffer_at(metaData->file_descriptor, page, PAGE_SIZE, page_start);
+
+    // a page allocated but never written ends beyond the file
+    if (nbytes < PAGE_SIZE)
+        memset((char *)page + nbytes, 0, PAGE_SIZE - nbytes);
 }
 
-void BTreePager::sync(int page_id)
+void BTreePager::write_page(uint64_t page_id, const void * page)
 {
-    if (pages[page_id] == nullptr)
-        return;
+    // write page back to disk
+    if (write_barrier != nullptr)
+        write_barrier(page);
 
-    // seek to write position
-    off_t page_start = metaData->get_data_size() + page_id * PAGE_SIZE;
-    off_t status = lseek(metaData->file_descriptor, page_start, SEEK_SET);
-    if (status < 0)
+    off_t page_start = BtreeMetaData::page_offset(page_id);
+    auto nbytes = write_buffer_at(metaData->file_descriptor, page, PAGE_SIZE, page_start);
+    assert(nbytes == PAGE_SIZE);
+}
+
+void BTreePager::run_batch(const BufferPool::PageBatch & pages, PageRequest::Type type)
+{
+    std::vector<PageRequest> requests(pages.size());
+    for (size_t i = 0; i < pages.size(); ++i)
     {
-        fprintf(stderr, "lseek error\n");
-        exit(EXIT_FAILURE);
+        requests[i].type = type;
+        requests[i].buffer = pages[i].second;
+        requests[i].length = PAGE_SIZE;
+        requests[i].offset = BtreeMetaData::page_offset(pages[i].first);
+
+        if (type == PageRequest::Type::WRITE && write_barrier != nullptr)
+            write_barrier(pages[i].second);
     }
-    assert(status == page_start);
 
-    // write page back to disk
-    auto nbytes = write_buffer(metaData->file_descriptor, pages[page_id], PAGE_SIZE);
+    async_io->run(requests);
 
-    assert(nbytes == PAGE_SIZE);
+    // a read past the end of the file is short, the rest of the page is zero
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        auto & request = requests[i];
+        if (request.result < 0)
+        {
+            fprintf(stderr, "%s page %llu error\n", type == PageRequest::Type::READ ? "read" : "write", (unsigned long long)pages[i].first);
+            exit(EXIT_FAILURE);
+        }
+        if (type == PageRequest::Type::WRITE && (size_t)request.result != PAGE_SIZE)
+        {
+            fprintf(stderr, "short write of page %llu: %zd bytes\n", (unsigned long long)pages[i].first, request.result);
+            exit(EXIT_FAILURE);
+        }
+        if ((size_t)request.result < PAGE_SIZE)
+            memset((char *)request.buffer + request.result, 0, PAGE_SIZE - request.result);
+    }
+}
+
+void BTreePager::sync(int page_id)
+{
+    page_cache->flush(page_id);
 }
 
 void BTreePager::flush_page(int page_id, size_t size)
 {
-    if (pages[page_id] == nullptr)
-        return;
-    sync(page_id);
-    free(pages[page_id]);
-    pages[page_id] = nullptr;
-}
\ No newline at end of file
+    page_cache->evict(page_id);
+}
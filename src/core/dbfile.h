@@ -2,6 +2,7 @@
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
+#include <functional>
 #include <string>
 #include <fcntl.h>
 #include <unistd.h>
@@ -11,6 +12,9 @@
 #include <sys/types.h>
 #include <sys/uio.h>
 
+#include "buffer_pool.h"
+#include "mmap_cache.h"
+#include "page_io.h"
 #include "parameters.h"
 
 class Pager
@@ -38,23 +42,42 @@ public:
 
 private:
     off_t get_file_length();
+
+    // memory of loaded pages, a flushed page returns its frame
+    PageArena arena;
 };
 
 
+/**
+ * @brief header page of a b+tree file
+ * layout: [magic, root_pid, num_pages, free_head, num_free] padded to
+ *  PAGE_SIZE, data pages follow so that every page is block aligned
+ *  freed pages form a list: a free page starts with the id of the next
+ *  free page, free_head is the first one
+ */
 struct BtreeMetaData
 {
+    static const uint64_t MAGIC = 0x65657274622d7964; // "dy-btree"
+
     const std::string file_path;
     const int file_descriptor;
     uint64_t root_pid;
     uint64_t num_pages;
+    uint64_t free_head;
+    uint64_t num_free;
 
     BtreeMetaData(const std::string & path, int fd) : file_path(path), file_descriptor(fd)
     {
         root_pid = 0;
         num_pages = 0;
+        free_head = PAGE_ID_INVALID;
+        num_free = 0;
     }
 
-    int inline get_data_size() const { return sizeof(uint64_t) + sizeof(uint64_t); }
+    int inline get_data_size() const { return 5 * sizeof(uint64_t); }
+
+    // position of a data page in the file, page 0 of the file is the header
+    static inline off_t page_offset(uint64_t page_id) { return (off_t)(page_id + 1) * PAGE_SIZE; }
 
     // write meta data into file
     void write_to_disk();
@@ -63,27 +86,190 @@ struct BtreeMetaData
     void load_from_disk();
 };
 
+// how a BTreePager keeps pages in memory
+enum class PagerBackend
+{
+    // pages are copied into a bounded BufferPool
+    BUFFER_POOL,
+    // pages are served from a shared mapping of the file
+    MMAP
+};
+
+// how the buffer pool issues batches of page io
+enum class IoEngine
+{
+    // one blocking pread/pwrite at a time
+    SYNC,
+    // io_uring, or a thread pool when io_uring is not available
+    ASYNC,
+    // always use the thread pool
+    THREAD_POOL
+};
+
+struct PagerOptions
+{
+    PagerBackend backend = PagerBackend::BUFFER_POOL;
+    IoEngine io_engine = IoEngine::SYNC;
+
+    // requests kept in flight by the async engine
+    unsigned io_queue_depth = 64;
+    // workers of the thread pool engine
+    size_t io_threads = 4;
+
+    // max number of pages kept in memory by the buffer pool
+    size_t pool_pages = BUFFER_POOL_DEFAULT_PAGES;
+
+    // max number of pages of the file in mmap mode
+    size_t mmap_max_pages = MMAP_DEFAULT_MAX_PAGES;
+
+    // max pages read ahead of a sequential scan by an async io engine, the
+    // window starts small and doubles while the scan stays sequential.
+    // 0 disables readahead and prefetch
+    size_t readahead_pages = 32;
+
+    // back the frames of the buffer pool by huge pages
+    HugePages huge_pages = HugePages::NONE;
+
+    // bypass the kernel page cache (O_DIRECT) so that pages are cached by
+    // the buffer pool only, falls back to buffered io when the file system
+    // does not support it
+    bool direct_io = false;
+
+    // incremental checkpoint: while more than checkpoint_dirty_pages pages
+    // are dirty, each checkpoint step writes checkpoint_step_pages of them
+    // in page id order. 0 disables the steps
+    size_t checkpoint_step_pages = 8;
+    size_t checkpoint_dirty_pages = 64;
+};
+
 class BTreePager : public Pager
 {
 public:
     // mode: 'c' : create new database
     // mode: 'o' : open exist database for io
-    BTreePager(const std::string & path, char mode);
+    BTreePager(const std::string & path, char mode, const PagerOptions & options = PagerOptions());
     virtual ~BTreePager() override;
     virtual void * get_page(int page_id) override;
     virtual void flush_page(int page_id, size_t size = PAGE_SIZE) override;
+    // reuse a page of the free list or append a page to the file,
+    // the new page is zero filled
     uint64_t allocate_page(void *& new_page);
+
+    // put a page which is no longer referenced on the free list
+    void free_page(uint64_t page_id);
+
+    // a pinned page stays in memory until it is unpinned
+    void * pin_page(uint64_t page_id);
+    void unpin_page(uint64_t page_id);
+
+    // a page must be marked dirty after its content changed,
+    // otherwise the change is lost when the page is evicted
+    // lsn: log group which redoes the change, 0 when not logged
+    void mark_dirty(uint64_t page_id, uint64_t lsn = 0);
+
+    // write back a few dirty pages so that write io is spread over the
+    // run instead of arriving at close, return number of pages written.
+    // pages changed by log groups >= durable_lsn are left for later
+    size_t checkpoint_step(uint64_t durable_lsn = UINT64_MAX);
+
+    // log groups older than this lsn are not needed by any dirty page
+    inline uint64_t oldest_dirty_lsn() const { return page_cache->oldest_dirty_lsn(); }
+    inline size_t num_dirty_pages() const { return page_cache->num_dirty(); }
+
+    // start loading pages which will be visited soon: async reads into
+    // the pool with an async io engine, a kernel readahead hint otherwise
+    void prefetch(const std::vector<uint64_t> & page_ids);
+
+    // called with a page before it is written to disk and with nullptr
+    // before the meta data is written, a write ahead log uses it to force
+    // the log ahead of the pages
+    using WriteBarrier = std::function<void(const void *)>;
+    void set_write_barrier(WriteBarrier barrier);
+
+    // grow the file to num_pages pages, pages never written read as zeros
+    void extend_to(uint64_t num_pages);
+
+    // set the free list, used when the allocator state is restored from a log
+    void restore_free_list(uint64_t free_head, uint64_t num_free);
+
+    // write every dirty page and the meta data then sync the file
+    // the meta data is only written here, by sync_metadata and at close
+    void sync_to_disk();
+
+    // write the meta data then sync pages written so far
+    void sync_metadata();
+
+    // whether pages may be read with peek_page by other threads while one
+    // thread changes the file: pages of the mmap backend are reached by
+    // their address, the buffer pool changes its frames on every access
+    inline bool shared_reads() const { return mmap_backend; }
+    // page for a reader which takes no lock of the pager, nullptr when
+    // page_id is beyond the file. only with shared_reads
+    inline const void * peek_page(uint64_t page_id) const { return page_cache->peek(page_id); }
+
     inline uint64_t num_pages() const { return metaData->num_pages; }
     inline uint64_t get_root_page() const { return metaData->root_pid; }
     inline void set_root_page(uint64_t page_id) { metaData->root_pid = page_id; }
+    inline uint64_t free_list_head() const { return metaData->free_head; }
+    inline uint64_t num_free_pages() const { return metaData->num_free; }
+    inline size_t num_resident_pages() const { return page_cache->num_resident(); }
+    inline size_t pool_capacity() const { return page_cache->capacity(); }
+    inline size_t cache_memory_bytes() const { return page_cache->memory_bytes(); }
+    inline const char * io_engine_name() const { return async_io == nullptr ? "sync" : async_io->name(); }
+    inline bool is_direct_io() const { return direct_io; }
 
 private:
     void sync(int page_id);
+    void check_page_id(int64_t page_id) const;
+    void write_metadata();
+
+    // move a page between disk and memory
+    void read_page(uint64_t page_id, void * page);
+    void write_page(uint64_t page_id, const void * page);
+    void run_batch(const BufferPool::PageBatch & pages, PageRequest::Type type);
+
+    // sequential readahead: a run of misses on consecutive pages opens a
+    // stream, reading within the stream keeps the window ahead of it
+    void on_access(uint64_t page_id);
+    void read_ahead(const std::vector<uint64_t> & page_ids);
 
 private:
     // shall remove at close
     BtreeMetaData * metaData;
-    void * pages[TABLE_MAX_PAGES];
+    PageCache * page_cache;
+    std::unique_ptr<AsyncPageIO> async_io;
+    WriteBarrier write_barrier;
+    size_t checkpoint_step_pages;
+    size_t checkpoint_dirty_pages;
+    bool direct_io;
+    bool mmap_backend;
+
+    // state of sequential readahead
+    size_t readahead_pages;
+    uint64_t last_miss;
+    size_t sequential_misses;
+    uint64_t readahead_next; // first page not read ahead yet, 0: no stream
+    size_t readahead_window;
+};
+
+/**
+ * @brief pin a page of BTreePager for the lifetime of the guard
+ *  use it when a page pointer is kept across other pager calls
+ */
+class PageGuard
+{
+public:
+    PageGuard(BTreePager & pager, uint64_t page_id) : pager(pager), page_id(page_id) { data = pager.pin_page(page_id); }
+    ~PageGuard() { pager.unpin_page(page_id); }
+
+    PageGuard(const PageGuard &) = delete;
+    PageGuard & operator=(const PageGuard &) = delete;
+
+    void * data;
+
+private:
+    BTreePager & pager;
+    uint64_t page_id;
 };
 
 /**
@@ -105,4 +291,36 @@ ssize_t read_buffer(int fd, void * dst, size_t buffer_size);
  * @param buffer_size
  * @return ssize_t: true bytes loaded
  */
-ssize_t write_buffer(int fd, void * src, size_t buffer_size);
\ No newline at end of file
+ssize_t write_buffer(int fd, void * src, size_t buffer_size);
+
+/**
+ * @brief fill a buffer from file position offset until buffer
+ *          is full or EOF reached. file offset is not changed
+ *
+ * @param fd: file descriptor
+ * @param dst: start position of the buffer
+ * @param buffer_size
+ * @param offset: position in file to read from
+ * @return ssize_t: true bytes loaded
+ */
+ssize_t read_buffer_at(int fd, void * dst, size_t buffer_size, off_t offset);
+
+/**
+ * @brief write a buffer of size buffer_size into disk at position
+ *          offset. file offset is not changed
+ *
+ * @param fd: file descriptor
+ * @param src: start position of the buffer
+ * @param buffer_size
+ * @param offset: position in file to write to
+ * @return ssize_t: true bytes written
+ */
+ssize_t write_buffer_at(int fd, const void * src, size_t buffer_size, off_t offset);
+
+/**
+ * @brief flush file data written so far to the device
+ *  (fdatasync where available)
+ *
+ * @param fd: file descriptor
+ */
+void sync_file_data(int fd);
@@ -7,17 +7,19 @@ GlobalVariableHandler & GlobalVariableHandler::get_instance()
 }
 
 void GlobalVariableHandler::set_btree_paramters(
-    size_t rsize, char mode_, const std::string & db_path, uint32_t leaf_node, uint32_t inner_node)
+    size_t rsize, char mode_, const std::string & db_path, uint32_t leaf_node, uint32_t inner_node, const PagerOptions & options, const WalOptions & wal)
 {
     row_size = rsize;
     path = db_path;
     leaf_load_upper_bound = leaf_node;
     inner_node_load_upper_bound = inner_node;
     mode = mode_;
+    pager_options = options;
+    wal_options = wal;
 }
 
-BPlusTree & GlobalVariableHandler::get_btree()
+UserInfoBPlusTree & GlobalVariableHandler::get_btree()
 {
-    static BPlusTree btree(path, mode, row_size, leaf_load_upper_bound, inner_node_load_upper_bound);
+    static UserInfoBPlusTree btree(path, mode, row_size, leaf_load_upper_bound, inner_node_load_upper_bound, pager_options, wal_options);
     return btree;
 }
@@ -5,8 +5,9 @@ class GlobalVariableHandler
 {
 public:
     static GlobalVariableHandler & get_instance();
-    void set_btree_paramters(size_t rsize, char mode_, const std::string & db_path, uint32_t leaf_node = 10000, uint32_t inner_node = 1000);
-    BPlusTree & get_btree();
+    void set_btree_paramters(size_t rsize, char mode_, const std::string & db_path, uint32_t leaf_node = 10000, uint32_t inner_node = 1000,
+        const PagerOptions & options = PagerOptions(), const WalOptions & wal = WalOptions());
+    UserInfoBPlusTree & get_btree();
 
 
 private:
@@ -17,5 +18,7 @@ private:
     std::string path;
     uint32_t leaf_load_upper_bound;
     uint32_t inner_node_load_upper_bound;
+    PagerOptions pager_options;
+    WalOptions wal_options;
     char mode;
 };
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "key_search.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEY_SEARCH_X86
+#endif
+
+using LowerBound = uint32_t (*)(const uint32_t * keys, uint32_t n, uint32_t key);
+using LowerBound64 = uint32_t (*)(const uint64_t * keys, uint32_t n, uint64_t key);
+
+// binary search until at most max_left keys of [lo, lo + n) are left,
+// the lower bound stays in [lo, lo + n]. the halving has no branch on the
+// keys, so a probe never waits for a mispredicted compare
+template <typename Int>
+static inline void narrow(const Int * keys, uint32_t max_left, Int key, uint32_t & lo, uint32_t & n)
+{
+    while (n > max_left)
+    {
+        uint32_t half = n / 2;
+        bool less = keys[lo + half] < key;
+        lo = less ? lo + half + 1 : lo;
+        n = less ? n - half - 1 : half;
+    }
+}
+
+template <typename Int>
+static uint32_t lower_bound_scalar(const Int * keys, uint32_t n, Int key)
+{
+    uint32_t lo = 0;
+    narrow(keys, 0, key, lo, n);
+    return lo;
+}
+
+#ifdef KEY_SEARCH_X86
+// the last keys are compared in vectors: the lower bound is lo plus the
+// number of keys less than key. compares are signed, flipping the sign bit
+// keeps the order of unsigned keys
+
+__attribute__((target("sse4.2,popcnt"))) static uint32_t lower_bound_sse42(const uint32_t * keys, uint32_t n, uint32_t key)
+{
+    // 4 vectors, one cache line of keys
+    uint32_t lo = 0;
+    narrow(keys, 16, key, lo, n);
+
+    const __m128i flip = _mm_set1_epi32(INT32_MIN);
+    const __m128i query = _mm_xor_si128(_mm_set1_epi32((int)key), flip);
+    uint32_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(keys + lo + i));
+        __m128i less = _mm_cmpgt_epi32(query, _mm_xor_si128(block, flip));
+        count += _mm_popcnt_u32(_mm_movemask_ps(_mm_castsi128_ps(less)));
+    }
+    for (; i < n; ++i)
+        count += keys[lo + i] < key;
+    return lo + count;
+}
+
+__attribute__((target("avx2,popcnt"))) static uint32_t lower_bound_avx2(const uint32_t * keys, uint32_t n, uint32_t key)
+{
+    // 4 vectors, two cache lines of keys
+    uint32_t lo = 0;
+    narrow(keys, 32, key, lo, n);
+
+    const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+    const __m256i query = _mm256_xor_si256(_mm256_set1_epi32((int)key), flip);
+    uint32_t count = 0, i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(keys + lo + i));
+        __m256i less = _mm256_cmpgt_epi32(query, _mm256_xor_si256(block, flip));
+        count += _mm_popcnt_u32(_mm256_movemask_ps(_mm256_castsi256_ps(less)));
+    }
+    for (; i < n; ++i)
+        count += keys[lo + i] < key;
+    return lo + count;
+}
+
+// 64 bit keys take twice the lanes, the compares of 64 bit lanes come with
+// sse4.2 as well
+
+__attribute__((target("sse4.2,popcnt"))) static uint32_t lower_bound64_sse42(const uint64_t * keys, uint32_t n, uint64_t key)
+{
+    // 4 vectors, one cache line of keys
+    uint32_t lo = 0;
+    narrow(keys, 8, key, lo, n);
+
+    const __m128i flip = _mm_set1_epi64x(INT64_MIN);
+    const __m128i query = _mm_xor_si128(_mm_set1_epi64x((int64_t)key), flip);
+    uint32_t count = 0, i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(keys + lo + i));
+        __m128i less = _mm_cmpgt_epi64(query, _mm_xor_si128(block, flip));
+        count += _mm_popcnt_u32(_mm_movemask_pd(_mm_castsi128_pd(less)));
+    }
+    for (; i < n; ++i)
+        count += keys[lo + i] < key;
+    return lo + count;
+}
+
+__attribute__((target("avx2,popcnt"))) static uint32_t lower_bound64_avx2(const uint64_t * keys, uint32_t n, uint64_t key)
+{
+    // 4 vectors, two cache lines of keys
+    uint32_t lo = 0;
+    narrow(keys, 16, key, lo, n);
+
+    const __m256i flip = _mm256_set1_epi64x(INT64_MIN);
+    const __m256i query = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)key), flip);
+    uint32_t count = 0, i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(keys + lo + i));
+        __m256i less = _mm256_cmpgt_epi64(query, _mm256_xor_si256(block, flip));
+        count += _mm_popcnt_u32(_mm256_movemask_pd(_mm256_castsi256_pd(less)));
+    }
+    for (; i < n; ++i)
+        count += keys[lo + i] < key;
+    return lo + count;
+}
+#endif
+
+static LowerBound implementation_of(KeySearchIsa isa)
+{
+#ifdef KEY_SEARCH_X86
+    if (isa == KeySearchIsa::AVX2)
+        return lower_bound_avx2;
+    if (isa == KeySearchIsa::SSE42)
+        return lower_bound_sse42;
+#endif
+    return lower_bound_scalar<uint32_t>;
+}
+
+static LowerBound64 implementation64_of(KeySearchIsa isa)
+{
+#ifdef KEY_SEARCH_X86
+    if (isa == KeySearchIsa::AVX2)
+        return lower_bound64_avx2;
+    if (isa == KeySearchIsa::SSE42)
+        return lower_bound64_sse42;
+#endif
+    return lower_bound_scalar<uint64_t>;
+}
+
+// searches before the static initialization of this file use the scalar one
+static KeySearchIsa current_isa = KeySearchIsa::SCALAR;
+static LowerBound lower_bound = lower_bound_scalar<uint32_t>;
+static LowerBound64 lower_bound64 = lower_bound_scalar<uint64_t>;
+[[maybe_unused]] static bool picked_at_startup = set_key_search_isa(best_key_search_isa());
+
+uint32_t lower_bound_keys(const uint32_t * keys, uint32_t n, uint32_t key)
+{
+    return lower_bound(keys, n, key);
+}
+
+uint32_t lower_bound_keys(const uint64_t * keys, uint32_t n, uint64_t key)
+{
+    return lower_bound64(keys, n, key);
+}
+
+KeySearchIsa best_key_search_isa()
+{
+#ifdef KEY_SEARCH_X86
+    // cpu features may be asked before main
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return KeySearchIsa::AVX2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        return KeySearchIsa::SSE42;
+#endif
+    return KeySearchIsa::SCALAR;
+}
+
+bool set_key_search_isa(KeySearchIsa isa)
+{
+    if (isa > best_key_search_isa())
+        return false;
+
+    current_isa = isa;
+    lower_bound = implementation_of(isa);
+    lower_bound64 = implementation64_of(isa);
+    return true;
+}
+
+KeySearchIsa key_search_isa()
+{
+    return current_isa;
+}
+
+const char * key_search_isa_name(KeySearchIsa isa)
+{
+    switch (isa)
+    {
+        case KeySearchIsa::AVX2:
+            return "avx2";
+        case KeySearchIsa::SSE42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+
+// instruction sets of the key search inside a node
+enum class KeySearchIsa
+{
+    SCALAR,
+    SSE42,
+    AVX2
+};
+
+// first position pos of sorted keys with keys[pos] >= key, n when every key
+// is less. the implementation is picked at startup from what the cpu supports
+uint32_t lower_bound_keys(const uint32_t * keys, uint32_t n, uint32_t key);
+uint32_t lower_bound_keys(const uint64_t * keys, uint32_t n, uint64_t key);
+
+// widest instruction set supported by the cpu
+KeySearchIsa best_key_search_isa();
+
+// instruction set used by the searches, tests and benchmarks switch it to
+// compare the implementations. return false and keep the current one when
+// the cpu does not support isa
+bool set_key_search_isa(KeySearchIsa isa);
+KeySearchIsa key_search_isa();
+
+const char * key_search_isa_name(KeySearchIsa isa);
@@ -0,0 +1,139 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include "key_search.h"
+
+/**
+ * @brief how a b+tree keeps keys of type Key
+ * Stored: entry of the key arrays of nodes and head of a leaf cell, Key and
+ *  Stored convert into each other
+ * Value: a key which outlives the page it was read from
+ * separator: a key s.t. left_max <= key < right_min, what an inner node
+ *  keeps between two children
+ * successor: the least key larger than key
+ */
+template <typename Key>
+struct KeyTraits;
+
+// integer keys are stored as they are and searched with the vectorized search
+template <typename Int>
+struct IntegerKeyTraits
+{
+    using Stored = Int;
+    using Value = Int;
+
+    static uint32_t lower_bound(const Stored * keys, uint32_t n, Int key) { return lower_bound_keys(keys, n, key); }
+
+    static Value separator(Int left_max, Int /*right_min*/) { return left_max; }
+
+    static Value successor(Int key) { return key + 1; }
+
+    // every integer fits into an entry
+    static void check(Int /*key*/) { }
+
+    static std::string to_string(Int key) { return std::to_string(key); }
+};
+
+template <>
+struct KeyTraits<uint32_t> : IntegerKeyTraits<uint32_t>
+{
+};
+
+template <>
+struct KeyTraits<uint64_t> : IntegerKeyTraits<uint64_t>
+{
+};
+
+const uint32_t BYTE_KEY_MAX_SIZE = 63;
+
+/**
+ * @brief entry of a byte string key of at most BYTE_KEY_MAX_SIZE bytes.
+ *  entries have a fixed size, so nodes of byte keys keep the layout and
+ *  the load rules of integer keys. keys compare as unsigned bytes
+ */
+struct ByteKey
+{
+    uint8_t size;
+    char bytes[BYTE_KEY_MAX_SIZE];
+
+    // the size is cut for readers which read the entry while it changes
+    operator std::string_view() const { return std::string_view(bytes, std::min<uint32_t>(size, BYTE_KEY_MAX_SIZE)); }
+
+    // the key may point into this entry
+    ByteKey & operator=(std::string_view key)
+    {
+        assert(key.size() <= BYTE_KEY_MAX_SIZE);
+        size = key.size();
+        memmove(bytes, key.data(), size);
+        return *this;
+    }
+};
+
+template <>
+struct KeyTraits<std::string_view>
+{
+    using Stored = ByteKey;
+    using Value = std::string;
+
+    static uint32_t lower_bound(const Stored * keys, uint32_t n, std::string_view key)
+    {
+        uint32_t lo = 0;
+        while (n > 0)
+        {
+            uint32_t half = n / 2;
+            if (std::string_view(keys[lo + half]) < key)
+            {
+                lo += half + 1;
+                n -= half + 1;
+            }
+            else
+            {
+                n = half;
+            }
+        }
+        return lo;
+    }
+
+    // the shortest such key: the common prefix and one more byte when it
+    // separates, otherwise left_max. short separators keep the compares of
+    // a descent short
+    static Value separator(std::string_view left_max, std::string_view right_min)
+    {
+        assert(left_max < right_min);
+        size_t p = 0;
+        while (p < left_max.size() && p < right_min.size() && left_max[p] == right_min[p])
+            p += 1;
+
+        // left_max is a prefix of right_min
+        if (p == left_max.size())
+            return Value(left_max);
+
+        // right_min is longer than the common prefix and its next byte
+        if (right_min.size() > p + 1)
+            return Value(right_min.substr(0, p + 1));
+
+        // a byte between the two next bytes
+        if ((uint8_t)left_max[p] + 1 < (uint8_t)right_min[p])
+        {
+            Value key(left_max.substr(0, p + 1));
+            key[p] += 1;
+            return key;
+        }
+        return Value(left_max);
+    }
+
+    static Value successor(std::string_view key) { return Value(key) + '\0'; }
+
+    static void check(std::string_view key)
+    {
+        if (key.size() > BYTE_KEY_MAX_SIZE)
+            throw std::runtime_error("byte key longer than " + std::to_string(BYTE_KEY_MAX_SIZE) + " bytes");
+    }
+
+    static std::string to_string(std::string_view key) { return Value(key); }
+};
@@ -0,0 +1,65 @@
+#include "latch.h"
+#include <cstdio>
+#include <cstdlib>
+
+// 2^28 pages, a terabyte of 4 kB pages. a chunk is allocated on the first
+// lock of one of its pages
+static const uint64_t LATCH_CHUNK_SIZE = 1 << 14;
+static const uint64_t LATCH_NUM_CHUNKS = 1 << 14;
+
+NodeLatches::NodeLatches() : chunks(new std::atomic<OptimisticLatch *>[LATCH_NUM_CHUNKS])
+{
+    for (uint64_t i = 0; i < LATCH_NUM_CHUNKS; ++i)
+        chunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+NodeLatches::~NodeLatches()
+{
+    for (uint64_t i = 0; i < LATCH_NUM_CHUNKS; ++i)
+        delete[] chunks[i].load(std::memory_order_relaxed);
+}
+
+const OptimisticLatch * NodeLatches::find(uint64_t page_id) const
+{
+    if (page_id >= LATCH_CHUNK_SIZE * LATCH_NUM_CHUNKS)
+        return nullptr;
+
+    const OptimisticLatch * chunk = chunks[page_id / LATCH_CHUNK_SIZE].load(std::memory_order_acquire);
+    return chunk == nullptr ? nullptr : chunk + page_id % LATCH_CHUNK_SIZE;
+}
+
+uint64_t NodeLatches::read_lock(uint64_t page_id) const
+{
+    const OptimisticLatch * latch = find(page_id);
+    return latch == nullptr ? 0 : latch->read_lock();
+}
+
+bool NodeLatches::validate(uint64_t page_id, uint64_t version) const
+{
+    if (page_id >= LATCH_CHUNK_SIZE * LATCH_NUM_CHUNKS)
+        return false;
+
+    // the reads of the node come before the chunk is looked up again
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const OptimisticLatch * latch = find(page_id);
+    return latch == nullptr ? version == 0 : latch->validate(version);
+}
+
+void NodeLatches::write_lock(uint64_t page_id)
+{
+    if (page_id >= LATCH_CHUNK_SIZE * LATCH_NUM_CHUNKS)
+    {
+        fprintf(stderr, "page %llu has no latch\n", (unsigned long long)page_id);
+        exit(EXIT_FAILURE);
+    }
+
+    auto & chunk = chunks[page_id / LATCH_CHUNK_SIZE];
+    if (chunk.load(std::memory_order_relaxed) == nullptr)
+        chunk.store(new OptimisticLatch[LATCH_CHUNK_SIZE], std::memory_order_release);
+    chunk.load(std::memory_order_relaxed)[page_id % LATCH_CHUNK_SIZE].write_lock();
+}
+
+void NodeLatches::write_unlock(uint64_t page_id)
+{
+    chunks[page_id / LATCH_CHUNK_SIZE].load(std::memory_order_relaxed)[page_id % LATCH_CHUNK_SIZE].write_unlock();
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// reads of a locked latch spin this often before they yield the cpu
+const int LATCH_SPINS = 64;
+
+/**
+ * @brief version latch of a node for optimistic lock coupling
+ *  a reader takes the version, reads the node without writing anything
+ *  shared and then validates that the version is unchanged, otherwise it
+ *  restarts. a writer locks the latch, which makes the version odd, and
+ *  unlocks it to the next even version. writers are never blocked by
+ *  readers, they are serialized by the owner of the latch
+ */
+class OptimisticLatch
+{
+public:
+    OptimisticLatch() : version(0) { }
+
+    static inline bool is_locked(uint64_t version) { return (version & 1) != 0; }
+
+    // version of the latch once no writer holds it
+    inline uint64_t read_lock() const
+    {
+        uint64_t v = version.load(std::memory_order_acquire);
+        for (int spins = 0; is_locked(v); ++spins)
+        {
+            if (spins >= LATCH_SPINS)
+                std::this_thread::yield();
+            v = version.load(std::memory_order_acquire);
+        }
+        return v;
+    }
+
+    // whether nothing was changed since read_lock returned v, the reads of
+    // the node are ordered before the check
+    inline bool validate(uint64_t v) const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return version.load(std::memory_order_relaxed) == v;
+    }
+
+    // the changes of the writer are ordered after the lock and before the unlock
+    inline void write_lock() { version.fetch_add(1, std::memory_order_acq_rel); }
+    inline void write_unlock() { version.fetch_add(1, std::memory_order_release); }
+
+private:
+    std::atomic<uint64_t> version;
+};
+
+/**
+ * @brief latches of the nodes of a file, indexed by page id
+ *  latches are allocated in chunks which never move, so readers find the
+ *  latch of a page while the writer adds pages. a page whose chunk is not
+ *  allocated was never locked and has version 0. a freed page keeps its
+ *  latch, so readers which still hold its old version restart
+ */
+class NodeLatches
+{
+public:
+    NodeLatches();
+    ~NodeLatches();
+
+    NodeLatches(const NodeLatches &) = delete;
+    NodeLatches & operator=(const NodeLatches &) = delete;
+
+    // a page id read from a node which is being changed may be anything,
+    // the version of an id out of range never validates
+    uint64_t read_lock(uint64_t page_id) const;
+    bool validate(uint64_t page_id, uint64_t version) const;
+
+    // called by the single writer, the chunk of page_id is allocated here
+    void write_lock(uint64_t page_id);
+    void write_unlock(uint64_t page_id);
+
+private:
+    const OptimisticLatch * find(uint64_t page_id) const;
+
+    std::unique_ptr<std::atomic<OptimisticLatch *>[]> chunks;
+};
@@ -0,0 +1,190 @@
+#include "mmap_cache.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// number of pages the mapping grows by at least
+const uint64_t MMAP_GROW_PAGES = 64;
+
+static size_t round_up(size_t value, size_t unit)
+{
+    return (value + unit - 1) / unit * unit;
+}
+
+MmapPageCache::MmapPageCache(int fd, off_t data_offset, uint64_t num_pages, size_t max_pages)
+    : file_descriptor(fd)
+    , data_offset(data_offset)
+    , max_pages(max_pages)
+    , os_page_size(sysconf(_SC_PAGESIZE))
+    , mapped_pages(0)
+    , num_pages(num_pages)
+{
+    if (num_pages > max_pages)
+    {
+        fprintf(stderr, "file holds %llu pages, more than mmap limit %zu\n", (unsigned long long)num_pages, max_pages);
+        exit(EXIT_FAILURE);
+    }
+
+    // reserve address space only, file is mapped into it on demand
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+    reserved_bytes = round_up(data_offset + max_pages * PAGE_SIZE, os_page_size);
+    void * addr = mmap(nullptr, reserved_bytes, PROT_NONE, flags, -1, 0);
+    if (addr == MAP_FAILED)
+    {
+        perror("reserve address space error");
+        exit(EXIT_FAILURE);
+    }
+    base = (char *)addr;
+
+    ensure_mapped(num_pages);
+}
+
+MmapPageCache::~MmapPageCache()
+{
+    flush_all();
+    munmap(base, reserved_bytes);
+
+    // drop the unused tail left by ensure_mapped
+    if (ftruncate(file_descriptor, data_offset + num_pages * PAGE_SIZE) < 0)
+        perror("truncate file error");
+}
+
+void * MmapPageCache::fetch(uint64_t page_id)
+{
+    assert(page_id < num_pages);
+    return page_address(page_id);
+}
+
+const void * MmapPageCache::peek(uint64_t page_id) const
+{
+    // the tail is mapped before mapped_pages grows
+    if (page_id >= mapped_pages.load(std::memory_order_acquire))
+        return nullptr;
+    return page_address(page_id);
+}
+
+void * MmapPageCache::create(uint64_t page_id)
+{
+    ensure_mapped(page_id + 1);
+    num_pages = std::max(num_pages, page_id + 1);
+
+    char * page = page_address(page_id);
+    memset(page, 0, PAGE_SIZE);
+    return page;
+}
+
+void MmapPageCache::flush(uint64_t page_id)
+{
+    if (page_id >= num_pages)
+        return;
+
+    char * start;
+    size_t length;
+    page_range(page_id, start, length);
+    if (msync(start, length, MS_ASYNC) < 0)
+        perror("msync error");
+}
+
+void MmapPageCache::evict(uint64_t page_id)
+{
+    // residency is decided by the kernel, the page only has to reach the file
+    flush(page_id);
+}
+
+void MmapPageCache::flush_all()
+{
+    if (mapped_pages == 0)
+        return;
+
+    size_t length = round_up(data_offset + mapped_pages * PAGE_SIZE, os_page_size);
+    if (msync(base, length, MS_ASYNC) < 0)
+        perror("msync error");
+}
+
+void MmapPageCache::ensure_mapped(uint64_t n)
+{
+    if (n <= mapped_pages)
+        return;
+
+    if (n > max_pages)
+    {
+        fprintf(stderr, "page %llu exceeds mmap limit %zu\n", (unsigned long long)n - 1, max_pages);
+        exit(EXIT_FAILURE);
+    }
+
+    // grow geometrically so that appending pages remaps rarely
+    uint64_t new_pages = std::max<uint64_t>(mapped_pages * 2, MMAP_GROW_PAGES);
+    new_pages = std::min<uint64_t>(std::max<uint64_t>(new_pages, n), max_pages);
+
+    // extend the file first, touching a mapped page beyond EOF raises SIGBUS
+    off_t file_bytes = data_offset + new_pages * PAGE_SIZE;
+    struct stat buf;
+    if (fstat(file_descriptor, &buf) < 0)
+    {
+        perror("get file state error");
+        exit(EXIT_FAILURE);
+    }
+    if (buf.st_size < file_bytes && ftruncate(file_descriptor, file_bytes) < 0)
+    {
+        perror("extend file error");
+        exit(EXIT_FAILURE);
+    }
+
+    // map the new tail in place of the reservation, pages mapped before keep their address
+    size_t old_bytes = mapped_pages == 0 ? 0 : round_up(data_offset + mapped_pages * PAGE_SIZE, os_page_size);
+    size_t new_bytes = round_up(file_bytes, os_page_size);
+    if (new_bytes > old_bytes)
+    {
+        void * addr = mmap(
+            base + old_bytes, new_bytes - old_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, file_descriptor, old_bytes);
+        if (addr == MAP_FAILED)
+        {
+            perror("mmap file error");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    mapped_pages.store(new_pages, std::memory_order_release);
+}
+
+void MmapPageCache::prefetch(const std::vector<uint64_t> & page_ids)
+{
+    // one advice per run of consecutive pages
+    size_t i = 0;
+    while (i < page_ids.size())
+    {
+        size_t j = i + 1;
+        while (j < page_ids.size() && page_ids[j] == page_ids[j - 1] + 1)
+            j += 1;
+
+        uint64_t last = std::min<uint64_t>(page_ids[j - 1], mapped_pages - 1);
+        if (page_ids[i] < mapped_pages)
+        {
+            char * start, * last_start;
+            size_t length, last_length;
+            page_range(page_ids[i], start, length);
+            page_range(last, last_start, last_length);
+            madvise(start, last_start + last_length - start, MADV_WILLNEED);
+        }
+        i = j;
+    }
+}
+
+void MmapPageCache::page_range(uint64_t page_id, char *& start, size_t & length) const
+{
+    size_t begin = data_offset + page_id * PAGE_SIZE;
+    size_t end = begin + PAGE_SIZE;
+    begin = begin / os_page_size * os_page_size;
+    end = round_up(end, os_page_size);
+
+    start = base + begin;
+    length = end - begin;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "buffer_pool.h"
+#include "parameters.h"
+
+/**
+ * @brief pages are served directly from a shared mapping of the file
+ *  no page is copied: the kernel page cache is the only cache.
+ *  address space for max_pages pages is reserved up front so the mapping
+ *  never moves when the file grows, a page pointer is valid until the
+ *  cache is destroyed. pin and unpin are therefore no-ops
+ */
+class MmapPageCache : public PageCache
+{
+public:
+    // data_offset: file offset of page 0
+    // num_pages: number of pages already in the file
+    // max_pages: upper bound of the pages the file may grow to
+    MmapPageCache(int fd, off_t data_offset, uint64_t num_pages, size_t max_pages);
+    virtual ~MmapPageCache() override;
+
+    MmapPageCache(const MmapPageCache &) = delete;
+    MmapPageCache & operator=(const MmapPageCache &) = delete;
+
+    virtual void * fetch(uint64_t page_id) override;
+    virtual void * create(uint64_t page_id) override;
+    virtual void pin(uint64_t /*page_id*/) override { }
+    virtual void unpin(uint64_t /*page_id*/) override { }
+    virtual void mark_dirty(uint64_t /*page_id*/, uint64_t /*lsn*/ = 0) override { }
+    virtual void flush(uint64_t page_id) override;
+    virtual void evict(uint64_t page_id) override;
+    virtual void flush_all() override;
+
+    // ask the kernel to read the pages in (madvise)
+    virtual void prefetch(const std::vector<uint64_t> & page_ids) override;
+
+    // a page is reached by its address, readers only need the mapping to
+    // cover it
+    virtual const void * peek(uint64_t page_id) const override;
+
+    virtual size_t capacity() const override { return max_pages; }
+    virtual size_t num_resident() const override { return num_pages; }
+
+private:
+    inline char * page_address(uint64_t page_id) const { return base + data_offset + page_id * PAGE_SIZE; }
+
+    // grow the file and the mapping so that it holds at least n pages
+    void ensure_mapped(uint64_t n);
+
+    // [start, end) rounded outward to boundaries of os pages
+    void page_range(uint64_t page_id, char *& start, size_t & length) const;
+
+    const int file_descriptor;
+    const off_t data_offset;
+    const size_t max_pages;
+    const size_t os_page_size;
+
+    char * base; // start of the reserved address space
+    size_t reserved_bytes;
+    // pages covered by the file and the mapping, read by peek on any thread
+    std::atomic<uint64_t> mapped_pages;
+    uint64_t num_pages; // pages used by the pager
+};
@@ -0,0 +1,83 @@
+#include "page_arena.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/mman.h>
+
+const size_t HUGE_PAGE_SIZE = 2 << 20;
+
+PageArena::PageArena(size_t num_frames, HugePages huge_pages)
+    : num_frames(num_frames), base(nullptr), mapped_bytes(0), backing(HugePages::NONE), num_used(0)
+{
+    if (num_frames == 0)
+    {
+        fprintf(stderr, "page arena shall contain at least one frame\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // huge pages need a mapping of whole huge pages
+    mapped_bytes = num_frames * PAGE_SIZE;
+    if (huge_pages != HugePages::NONE)
+        mapped_bytes = (mapped_bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+
+    void * memory = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if (huge_pages == HugePages::EXPLICIT)
+    {
+        memory = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED)
+            backing = HugePages::EXPLICIT;
+    }
+#endif
+
+    if (memory == MAP_FAILED)
+    {
+        memory = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            perror("map page arena error");
+            exit(EXIT_FAILURE);
+        }
+
+#ifdef MADV_HUGEPAGE
+        if (huge_pages != HugePages::NONE && madvise(memory, mapped_bytes, MADV_HUGEPAGE) == 0)
+            backing = HugePages::TRANSPARENT;
+#endif
+    }
+
+    base = (char *)memory;
+}
+
+PageArena::~PageArena()
+{
+    munmap(base, mapped_bytes);
+}
+
+void * PageArena::allocate()
+{
+    if (!free_frames.empty())
+    {
+        void * frame = free_frames.back();
+        free_frames.pop_back();
+        return frame;
+    }
+
+    // frames are handed out in address order, untouched memory is not
+    // backed until it is used
+    if (num_used == num_frames)
+    {
+        fprintf(stderr, "page arena of %zu frames is exhausted\n", num_frames);
+        exit(EXIT_FAILURE);
+    }
+
+    void * frame = base + num_used * PAGE_SIZE;
+    num_used += 1;
+    return frame;
+}
+
+void PageArena::release(void * frame)
+{
+    assert(contains(frame));
+    assert(((const char *)frame - base) % PAGE_SIZE == 0);
+    free_frames.push_back(frame);
+}
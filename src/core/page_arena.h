@@ -0,0 +1,63 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "parameters.h"
+
+// how the memory of a PageArena is backed
+enum class HugePages
+{
+    // regular os pages
+    NONE,
+    // ask for transparent huge pages (madvise), the kernel may ignore it
+    TRANSPARENT,
+    // reserved huge pages (MAP_HUGETLB), falls back to TRANSPARENT when
+    // none are available
+    EXPLICIT
+};
+
+/**
+ * @brief fixed number of page frames carved out of one contiguous
+ *  mapping which is reserved up front. frames are PAGE_SIZE aligned so
+ *  that they can be used for direct io. a released frame is handed out
+ *  again by the next allocate, memory is returned to the os only when
+ *  the arena is destroyed
+ */
+class PageArena
+{
+public:
+    PageArena(size_t num_frames, HugePages huge_pages = HugePages::NONE);
+    ~PageArena();
+
+    PageArena(const PageArena &) = delete;
+    PageArena & operator=(const PageArena &) = delete;
+
+    // get an unused frame, exit when every frame is in use
+    void * allocate();
+    void release(void * frame);
+
+    inline bool contains(const void * frame) const
+    {
+        return (const char *)frame >= base && (const char *)frame < base + num_frames * PAGE_SIZE;
+    }
+
+    inline size_t capacity() const { return num_frames; }
+    inline size_t num_allocated() const { return num_used - free_frames.size(); }
+
+    // size of the mapping, the memory used by the frames of the arena
+    inline size_t reserved_bytes() const { return mapped_bytes; }
+
+    // backing which was actually obtained
+    inline HugePages huge_pages() const { return backing; }
+
+private:
+    const size_t num_frames;
+    char * base;
+    size_t mapped_bytes;
+    HugePages backing;
+
+    // frames [0, num_used) were handed out at least once
+    size_t num_used;
+    std::vector<void *> free_frames;
+};
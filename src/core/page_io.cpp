@@ -0,0 +1,276 @@
+#include "page_io.h"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "dbfile.h"
+
+#ifdef DBTOY_HAS_IO_URING
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+void AsyncPageIO::run(std::vector<PageRequest> & requests)
+{
+    for (auto & request : requests)
+        submit(&request);
+    wait();
+}
+
+std::unique_ptr<AsyncPageIO> AsyncPageIO::create(int fd, unsigned queue_depth, size_t num_threads)
+{
+#ifdef DBTOY_HAS_IO_URING
+    auto uring = UringPageIO::try_create(fd, queue_depth);
+    if (uring != nullptr)
+        return uring;
+#endif
+    return std::make_unique<ThreadPoolPageIO>(fd, num_threads);
+}
+
+// run a request with blocking io, used by the thread pool and to finish
+// short transfers
+static ssize_t run_blocking(int fd, PageRequest * request, size_t done)
+{
+    char * buffer = (char *)request->buffer + done;
+    size_t remain = request->length - done;
+    off_t offset = request->offset + done;
+
+    if (request->type == PageRequest::Type::READ)
+        return done + read_buffer_at(fd, buffer, remain, offset);
+    return done + write_buffer_at(fd, buffer, remain, offset);
+}
+
+ThreadPoolPageIO::ThreadPoolPageIO(int fd, size_t num_threads) : file_descriptor(fd), num_pending(0), stopped(false)
+{
+    if (num_threads == 0)
+        num_threads = 1;
+
+    for (size_t i = 0; i < num_threads; ++i)
+        workers.emplace_back(&ThreadPoolPageIO::work, this);
+}
+
+ThreadPoolPageIO::~ThreadPoolPageIO()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    request_ready.notify_all();
+
+    for (auto & worker : workers)
+        worker.join();
+}
+
+void ThreadPoolPageIO::submit(PageRequest * request)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(request);
+        num_pending += 1;
+    }
+    request_ready.notify_one();
+}
+
+void ThreadPoolPageIO::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    request_done.wait(lock, [this] { return num_pending == 0; });
+}
+
+void ThreadPoolPageIO::work()
+{
+    while (true)
+    {
+        PageRequest * request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            request_ready.wait(lock, [this] { return stopped || !queue.empty(); });
+            if (queue.empty())
+                return;
+
+            request = queue.front();
+            queue.pop_front();
+        }
+
+        request->result = run_blocking(file_descriptor, request, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_pending -= 1;
+        }
+        request_done.notify_all();
+    }
+}
+
+#ifdef DBTOY_HAS_IO_URING
+
+std::unique_ptr<UringPageIO> UringPageIO::try_create(int fd, unsigned queue_depth)
+{
+    std::unique_ptr<UringPageIO> engine(new UringPageIO(fd));
+    if (!engine->setup(queue_depth))
+        return nullptr;
+    return engine;
+}
+
+bool UringPageIO::setup(unsigned queue_depth)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    int fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (fd < 0)
+        return false;
+    ring_fd = fd;
+    num_entries = params.sq_entries;
+
+    // map submission ring, completion ring and submission entries
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED)
+    {
+        sq_ring = nullptr;
+        return false;
+    }
+
+    if (single_mmap)
+    {
+        cq_ring = sq_ring;
+    }
+    else
+    {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED)
+        {
+            cq_ring = nullptr;
+            return false;
+        }
+    }
+
+    sqe_array_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqe_array = mmap(nullptr, sqe_array_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqe_array == MAP_FAILED)
+    {
+        sqe_array = nullptr;
+        return false;
+    }
+
+    char * sq = (char *)sq_ring;
+    sq_head = (unsigned *)(sq + params.sq_off.head);
+    sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    sq_index = (unsigned *)(sq + params.sq_off.array);
+
+    char * cq = (char *)cq_ring;
+    cq_head = (unsigned *)(cq + params.cq_off.head);
+    cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+
+    return true;
+}
+
+UringPageIO::~UringPageIO()
+{
+    if (ring_fd >= 0 && num_queued + num_in_flight > 0)
+        wait();
+
+    if (sqe_array != nullptr)
+        munmap(sqe_array, sqe_array_size);
+    if (cq_ring != nullptr && cq_ring != sq_ring)
+        munmap(cq_ring, cq_ring_size);
+    if (sq_ring != nullptr)
+        munmap(sq_ring, sq_ring_size);
+    if (ring_fd >= 0)
+        close(ring_fd);
+}
+
+void UringPageIO::submit(PageRequest * request)
+{
+    // ring is full: let the kernel drain it first
+    if (num_queued + num_in_flight == num_entries)
+        enter(1);
+
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe * sqe = (struct io_uring_sqe *)sqe_array + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->type == PageRequest::Type::READ ? IORING_OP_READ : IORING_OP_WRITE;
+    sqe->fd = file_descriptor;
+    sqe->addr = (uint64_t)request->buffer;
+    sqe->len = request->length;
+    sqe->off = request->offset;
+    sqe->user_data = (uint64_t)request;
+    sq_index[index] = index;
+
+    // publish the entry to the kernel
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    num_queued += 1;
+}
+
+void UringPageIO::wait()
+{
+    while (num_queued + num_in_flight > 0)
+        enter(num_queued + num_in_flight);
+}
+
+void UringPageIO::enter(unsigned min_complete)
+{
+    unsigned to_submit = num_queued;
+    int status = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (status < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+        perror("io_uring_enter error");
+        exit(EXIT_FAILURE);
+    }
+
+    if (status > 0)
+    {
+        num_queued -= status;
+        num_in_flight += status;
+    }
+    reap();
+}
+
+void UringPageIO::reap()
+{
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        struct io_uring_cqe * cqe = (struct io_uring_cqe *)cqes + (head & *cq_mask);
+        complete((PageRequest *)cqe->user_data, cqe->res);
+        num_in_flight -= 1;
+        head += 1;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+void UringPageIO::complete(PageRequest * request, int result)
+{
+    // opcode not supported by this kernel: run the request synchronously
+    if (result == -EINVAL || result == -EOPNOTSUPP)
+        result = 0;
+
+    if (result < 0)
+    {
+        fprintf(stderr, "io_uring request error: %s\n", strerror(-result));
+        exit(EXIT_FAILURE);
+    }
+
+    size_t done = result;
+    if (done < request->length)
+        request->result = run_blocking(file_descriptor, request, done);
+    else
+        request->result = done;
+}
+
+#endif
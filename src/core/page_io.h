@@ -0,0 +1,132 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#    define DBTOY_HAS_IO_URING 1
+#endif
+
+/**
+ * @brief read or write of one buffer at a file offset
+ */
+struct PageRequest
+{
+    enum class Type
+    {
+        READ,
+        WRITE
+    };
+
+    Type type;
+    void * buffer;
+    size_t length;
+    off_t offset;
+
+    // bytes transferred, set when the request completes
+    ssize_t result = -1;
+};
+
+/**
+ * @brief engine that keeps many page requests of a file in flight
+ *  submit queues a request without waiting for it, wait blocks until
+ *  every submitted request is complete. a request and its buffer must
+ *  stay alive until wait returns
+ */
+class AsyncPageIO
+{
+public:
+    virtual ~AsyncPageIO(){};
+    virtual void submit(PageRequest * request) = 0;
+    virtual void wait() = 0;
+    virtual const char * name() const = 0;
+
+    // submit a batch then wait for all of it
+    void run(std::vector<PageRequest> & requests);
+
+    // io_uring when the kernel provides it, a pool of pread threads otherwise
+    static std::unique_ptr<AsyncPageIO> create(int fd, unsigned queue_depth, size_t num_threads);
+};
+
+/**
+ * @brief fallback engine: worker threads run blocking pread/pwrite
+ */
+class ThreadPoolPageIO : public AsyncPageIO
+{
+public:
+    ThreadPoolPageIO(int fd, size_t num_threads);
+    virtual ~ThreadPoolPageIO() override;
+
+    virtual void submit(PageRequest * request) override;
+    virtual void wait() override;
+    virtual const char * name() const override { return "thread_pool"; }
+
+private:
+    void work();
+
+    const int file_descriptor;
+    std::vector<std::thread> workers;
+    std::deque<PageRequest *> queue;
+    size_t num_pending; // submitted but not finished
+    bool stopped;
+    std::mutex mutex;
+    std::condition_variable request_ready;
+    std::condition_variable request_done;
+};
+
+#ifdef DBTOY_HAS_IO_URING
+/**
+ * @brief engine on a raw io_uring instance, requests are batched into
+ *  the submission queue and handed to the kernel with one syscall
+ */
+class UringPageIO : public AsyncPageIO
+{
+public:
+    // nullptr when io_uring is not available (old kernel, seccomp ...)
+    static std::unique_ptr<UringPageIO> try_create(int fd, unsigned queue_depth);
+    virtual ~UringPageIO() override;
+
+    virtual void submit(PageRequest * request) override;
+    virtual void wait() override;
+    virtual const char * name() const override { return "io_uring"; }
+
+private:
+    UringPageIO(int fd) : file_descriptor(fd) { }
+    bool setup(unsigned queue_depth);
+
+    // hand queued entries to the kernel, then reap at least min_complete
+    void enter(unsigned min_complete);
+    void reap();
+
+    // finish a completed request, short transfers are completed synchronously
+    void complete(PageRequest * request, int result);
+
+    const int file_descriptor;
+    int ring_fd = -1;
+    unsigned num_entries = 0;
+    unsigned num_queued = 0; // filled entries not handed to kernel
+    unsigned num_in_flight = 0; // entries handed to kernel and not reaped
+
+    void * sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void * cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    void * sqe_array = nullptr;
+    size_t sqe_array_size = 0;
+
+    unsigned * sq_head = nullptr;
+    unsigned * sq_tail = nullptr;
+    unsigned * sq_mask = nullptr;
+    unsigned * sq_index = nullptr;
+    unsigned * cq_head = nullptr;
+    unsigned * cq_tail = nullptr;
+    unsigned * cq_mask = nullptr;
+    void * cqes = nullptr;
+};
+#endif
@@ -1,6 +1,13 @@
 #pragma once
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 
 const size_t PAGE_SIZE = 4096;
-const size_t TABLE_MAX_PAGES = 1000;
\ No newline at end of file
+const size_t TABLE_MAX_PAGES = 1000;
+// default number of page frames cached by a BTreePager
+const size_t BUFFER_POOL_DEFAULT_PAGES = TABLE_MAX_PAGES;
+// default upper bound of the file size in pages when it is memory mapped
+const size_t MMAP_DEFAULT_MAX_PAGES = 1 << 20;
+// page id which refers to no page, e.g. the end of the free list
+const uint64_t PAGE_ID_INVALID = UINT64_MAX;
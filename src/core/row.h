@@ -71,11 +71,11 @@ public:
 
     virtual void deserialize(void * destination) override;
 
-    virtual int get_row_byte() override
-    {
-        // [id, username '\0', email '\0']
-        return sizeof(id) + COL_USERNAME_SIZE + COL_EMAIL_SIZE;
-    }
+    // [id, username '\0', email '\0'], the schema is fixed so the size is
+    // known at compile time
+    static constexpr uint32_t ROW_BYTE = sizeof(int) + COL_USERNAME_SIZE + COL_EMAIL_SIZE;
+
+    virtual int get_row_byte() override { return ROW_BYTE; }
 
     virtual std::string to_string() override;
 
@@ -0,0 +1,161 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+static inline uint64_t pack_range(uint64_t front, uint64_t back)
+{
+    return front << 32 | back;
+}
+
+static inline uint64_t range_front(uint64_t range)
+{
+    return range >> 32;
+}
+
+static inline uint64_t range_back(uint64_t range)
+{
+    return range & UINT32_MAX;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned num_threads) : job(nullptr), generation(0), num_running(0), stopped(false), failed(false)
+{
+    if (num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    blocks.reset(new Block[num_threads]);
+    for (unsigned i = 0; i < num_threads; ++i)
+        blocks[i].range.store(0, std::memory_order_relaxed);
+
+    for (unsigned i = 1; i < num_threads; ++i)
+        workers.emplace_back(&WorkStealingPool::work, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+    }
+    job_ready.notify_all();
+
+    for (auto & worker : workers)
+        worker.join();
+}
+
+void WorkStealingPool::run(size_t num_tasks, const Task & task)
+{
+    if (num_tasks == 0)
+        return;
+    if (num_tasks > UINT32_MAX)
+        throw std::runtime_error("a job holds at most " + std::to_string(UINT32_MAX) + " tasks");
+
+    // the blocks are dealt before the workers are woken under the mutex
+    unsigned n = num_threads();
+    for (unsigned i = 0; i < n; ++i)
+        blocks[i].range.store(pack_range(num_tasks * i / n, num_tasks * (i + 1) / n), std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &task;
+        generation += 1;
+        num_running = (unsigned)workers.size();
+        failed.store(false, std::memory_order_relaxed);
+        error = nullptr;
+    }
+    job_ready.notify_all();
+
+    run_tasks(0);
+
+    std::exception_ptr job_error;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        job_done.wait(lock, [this] { return num_running == 0; });
+        job = nullptr;
+        job_error = error;
+        error = nullptr;
+    }
+    if (job_error)
+        std::rethrow_exception(job_error);
+}
+
+void WorkStealingPool::work(unsigned worker)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_ready.wait(lock, [&] { return stopped || generation != seen; });
+            if (stopped)
+                return;
+            seen = generation;
+        }
+
+        run_tasks(worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            num_running -= 1;
+        }
+        job_done.notify_all();
+    }
+}
+
+void WorkStealingPool::run_tasks(unsigned worker)
+{
+    size_t task;
+    while (take(worker, task) || steal(worker, task))
+    {
+        // the tasks left after a failure are taken but not run
+        if (failed.load(std::memory_order_relaxed))
+            continue;
+
+        try
+        {
+            (*job)(worker, task);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error)
+                error = std::current_exception();
+            failed.store(true, std::memory_order_relaxed);
+        }
+    }
+}
+
+bool WorkStealingPool::take(unsigned worker, size_t & task)
+{
+    auto & range = blocks[worker].range;
+    uint64_t current = range.load(std::memory_order_relaxed);
+    while (range_front(current) < range_back(current))
+    {
+        if (range.compare_exchange_weak(current, pack_range(range_front(current) + 1, range_back(current)), std::memory_order_relaxed))
+        {
+            task = range_front(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WorkStealingPool::steal(unsigned worker, size_t & task)
+{
+    // victims are tried from the next thread on, so thieves spread out
+    unsigned n = num_threads();
+    for (unsigned i = 1; i < n; ++i)
+    {
+        auto & range = blocks[(worker + i) % n].range;
+        uint64_t current = range.load(std::memory_order_relaxed);
+        while (range_front(current) < range_back(current))
+        {
+            if (range.compare_exchange_weak(current, pack_range(range_front(current), range_back(current) - 1), std::memory_order_relaxed))
+            {
+                task = range_back(current) - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief threads which run the tasks 0..n-1 of a job and steal from each other
+ *  the tasks are dealt out in contiguous blocks, one per thread. a thread
+ *  takes tasks from the front of its block and, once it is empty, steals
+ *  from the back of the block of another thread, so neighbouring tasks
+ *  mostly run on one thread. the thread which calls run is worker 0
+ */
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(unsigned worker, size_t task)>;
+
+    // num_threads counts the calling thread, 0 takes one thread per cpu
+    explicit WorkStealingPool(unsigned num_threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+    // run task for every id in [0, num_tasks) and return once all ran. the
+    // first exception of a task is thrown here, tasks not started by then
+    // are skipped. one thread at a time calls run
+    void run(size_t num_tasks, const Task & task);
+
+    inline unsigned num_threads() const { return (unsigned)workers.size() + 1; }
+
+private:
+    void work(unsigned worker);
+
+    // run tasks of the own block then stolen ones until no block has any
+    void run_tasks(unsigned worker);
+    bool take(unsigned worker, size_t & task);
+    bool steal(unsigned worker, size_t & task);
+
+    // [front, back) of the tasks left in a block packed into one word, the
+    // owner and the thieves take a task with one compare and swap
+    struct alignas(64) Block
+    {
+        std::atomic<uint64_t> range;
+    };
+
+    std::unique_ptr<Block[]> blocks;
+    std::vector<std::thread> workers;
+    const Task * job;
+    uint64_t generation; // number of jobs, a new one wakes the workers
+    unsigned num_running; // workers not done with the job
+    bool stopped;
+    std::atomic<bool> failed;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+};
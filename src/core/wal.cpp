@@ -0,0 +1,295 @@
+#include "wal.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "dbfile.h"
+
+const uint64_t WAL_MAGIC = 0x6c61772d796f7464; // "dtoy-wal"
+const size_t WAL_HEADER_SIZE = 2 * sizeof(uint64_t);
+const size_t WAL_FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+// lsn, allocator state and number of records of a group
+const size_t WAL_GROUP_HEADER_SIZE = 4 * sizeof(uint64_t) + sizeof(uint32_t);
+
+uint32_t crc32(const void * data, size_t size)
+{
+    static uint32_t table[256] = {0};
+    static bool initialized = false;
+    if (!initialized)
+    {
+        for (uint32_t i = 0; i < 256; ++i)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        initialized = true;
+    }
+
+    uint32_t crc = 0xffffffffu;
+    const uint8_t * bytes = (const uint8_t *)data;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffffu;
+}
+
+template <typename T>
+static void put(std::string & out, T value)
+{
+    out.append((const char *)&value, sizeof(T));
+}
+
+template <typename T>
+static bool get(const std::string & in, size_t & pos, T & value)
+{
+    if (pos + sizeof(T) > in.size())
+        return false;
+    memcpy(&value, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+WriteAheadLog::WriteAheadLog(const std::string & path, char mode, const WalOptions & options)
+    : file_path(path), options(options), lsn_next(1), lsn_durable(1), file_tail(WAL_HEADER_SIZE), num_pending(0)
+{
+    int flags = O_RDWR | O_CREAT;
+    if (mode == 'c')
+        flags |= O_TRUNC;
+    open_file(flags);
+
+    uint64_t header[2] = {0, 0};
+    auto nbytes = read_buffer_at(file_descriptor, header, sizeof(header), 0);
+    if (nbytes == 0)
+    {
+        write_header();
+        sync_file_data(file_descriptor);
+        return;
+    }
+
+    if (nbytes != sizeof(header) || header[0] != WAL_MAGIC)
+    {
+        fprintf(stderr, "%s is not a write ahead log\n", path.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    lsn_next = lsn_durable = header[1];
+}
+
+WriteAheadLog::~WriteAheadLog()
+{
+    commit();
+    close(file_descriptor);
+}
+
+void WriteAheadLog::open_file(int flags)
+{
+    file_descriptor = open(file_path.c_str(), flags, S_IWUSR | S_IRUSR);
+    if (file_descriptor < 0)
+    {
+        perror("open write ahead log error");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void WriteAheadLog::write_header()
+{
+    uint64_t header[2] = {WAL_MAGIC, lsn_next};
+    write_buffer_at(file_descriptor, header, sizeof(header), 0);
+}
+
+uint64_t WriteAheadLog::append(WalGroup & group)
+{
+    group.lsn = lsn_next;
+    lsn_next += 1;
+
+    std::string payload;
+    put<uint64_t>(payload, group.lsn);
+    put<uint64_t>(payload, group.num_pages);
+    put<uint64_t>(payload, group.free_head);
+    put<uint64_t>(payload, group.num_free);
+    put<uint32_t>(payload, group.records.size());
+    for (auto & record : group.records)
+    {
+        put<uint8_t>(payload, (uint8_t)record.type);
+        put<uint64_t>(payload, record.page_id);
+        put<uint32_t>(payload, record.payload.size());
+        payload.append(record.payload);
+    }
+
+    frames.push_back({group.lsn, file_tail + (off_t)buffer.size()});
+    put<uint32_t>(buffer, payload.size());
+    put<uint32_t>(buffer, crc32(payload.data(), payload.size()));
+    buffer.append(payload);
+
+    // group commit: one sync for many groups
+    auto now = std::chrono::steady_clock::now();
+    if (num_pending == 0)
+        first_pending_time = now;
+    num_pending += 1;
+
+    if (num_pending >= options.group_commit_size || now - first_pending_time >= options.group_commit_interval)
+        commit();
+
+    return group.lsn;
+}
+
+void WriteAheadLog::commit()
+{
+    if (num_pending == 0)
+        return;
+
+    write_buffer_at(file_descriptor, buffer.data(), buffer.size(), file_tail);
+    sync_file_data(file_descriptor);
+
+    file_tail += buffer.size();
+    buffer.clear();
+    num_pending = 0;
+    lsn_durable = lsn_next;
+}
+
+void WriteAheadLog::flush_to(uint64_t lsn)
+{
+    // groups of an operation in progress are not appended yet
+    assert(lsn < lsn_next);
+    if (lsn >= lsn_durable)
+        commit();
+}
+
+void WriteAheadLog::reset()
+{
+    commit();
+    frames.clear();
+    rewrite();
+}
+
+void WriteAheadLog::truncate(uint64_t first_lsn)
+{
+    commit();
+
+    while (!frames.empty() && frames.front().first < first_lsn)
+        frames.pop_front();
+    rewrite();
+}
+
+void WriteAheadLog::rewrite()
+{
+    // write kept frames into a new file, a crash leaves either log intact.
+    // the log is never empty on disk, so its lsn never starts over
+    std::string tmp_path = file_path + ".tmp";
+    int tmp_fd = open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+    if (tmp_fd < 0)
+    {
+        perror("open write ahead log error");
+        exit(EXIT_FAILURE);
+    }
+
+    // lsn keeps growing so that page lsn on disk stay comparable
+    uint64_t header[2] = {WAL_MAGIC, first_lsn()};
+    write_buffer_at(tmp_fd, header, sizeof(header), 0);
+
+    off_t shift = frames.empty() ? file_tail - WAL_HEADER_SIZE : frames.front().second - WAL_HEADER_SIZE;
+    std::string chunk(1 << 16, '\0');
+    for (off_t offset = WAL_HEADER_SIZE + shift; offset < file_tail;)
+    {
+        size_t length = std::min<off_t>(chunk.size(), file_tail - offset);
+        read_buffer_at(file_descriptor, &chunk[0], length, offset);
+        write_buffer_at(tmp_fd, chunk.data(), length, offset - shift);
+        offset += length;
+    }
+    sync_file_data(tmp_fd);
+    close(tmp_fd);
+
+    if (rename(tmp_path.c_str(), file_path.c_str()) < 0)
+    {
+        perror("replace write ahead log error");
+        exit(EXIT_FAILURE);
+    }
+    close(file_descriptor);
+    open_file(O_RDWR);
+
+    // the rename itself shall survive a crash
+    auto slash = file_path.find_last_of('/');
+    std::string dir = slash == std::string::npos ? "." : file_path.substr(0, slash + 1);
+    int dir_fd = open(dir.c_str(), O_RDONLY);
+    if (dir_fd >= 0)
+    {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    for (auto & frame : frames)
+        frame.second -= shift;
+    file_tail -= shift;
+}
+
+void WriteAheadLog::replay(const std::function<void(const WalGroup &)> & apply)
+{
+    assert(num_pending == 0);
+
+    struct stat buf;
+    if (fstat(file_descriptor, &buf) < 0)
+    {
+        perror("get write ahead log state error");
+        exit(EXIT_FAILURE);
+    }
+
+    off_t offset = WAL_HEADER_SIZE;
+    while (true)
+    {
+        uint32_t frame_header[2];
+        if (read_buffer_at(file_descriptor, frame_header, WAL_FRAME_HEADER_SIZE, offset) != WAL_FRAME_HEADER_SIZE)
+            break;
+
+        // the length of a torn frame is garbage, check it before allocating
+        if (frame_header[0] < WAL_GROUP_HEADER_SIZE || offset + (off_t)WAL_FRAME_HEADER_SIZE + frame_header[0] > buf.st_size)
+            break;
+
+        std::string payload(frame_header[0], '\0');
+        if (read_buffer_at(file_descriptor, &payload[0], payload.size(), offset + WAL_FRAME_HEADER_SIZE) != (ssize_t)payload.size())
+            break;
+        if (crc32(payload.data(), payload.size()) != frame_header[1])
+            break;
+
+        WalGroup group;
+        size_t pos = 0;
+        uint32_t num_records = 0;
+        bool valid = get(payload, pos, group.lsn) && get(payload, pos, group.num_pages) && get(payload, pos, group.free_head)
+            && get(payload, pos, group.num_free) && get(payload, pos, num_records);
+        for (uint32_t i = 0; valid && i < num_records; ++i)
+        {
+            WalRecord record;
+            uint8_t type;
+            uint32_t size;
+            valid = get(payload, pos, type) && get(payload, pos, record.page_id) && get(payload, pos, size) && pos + size <= payload.size();
+            if (!valid)
+                break;
+
+            record.type = (WalRecordType)type;
+            record.payload = payload.substr(pos, size);
+            pos += size;
+            group.records.push_back(std::move(record));
+        }
+
+        if (!valid || group.lsn != lsn_next)
+            break;
+
+        // pages redone by the group may be written back while it is applied
+        lsn_next = lsn_durable = group.lsn + 1;
+        frames.push_back({group.lsn, offset});
+        apply(group);
+        offset += WAL_FRAME_HEADER_SIZE + payload.size();
+    }
+
+    // cut off a torn tail so that new frames follow the last valid one
+    if (ftruncate(file_descriptor, offset) < 0)
+    {
+        perror("truncate write ahead log error");
+        exit(EXIT_FAILURE);
+    }
+    file_tail = offset;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct WalOptions
+{
+    bool enabled = false;
+
+    // number of appended groups which share one fdatasync
+    size_t group_commit_size = 32;
+
+    // age of the oldest buffered group at which an append syncs the buffer.
+    // it is checked on append only, the last groups of a burst wait for the
+    // next append, so callers commit() once they are idle
+    std::chrono::microseconds group_commit_interval = std::chrono::microseconds(2000);
+
+    // once the log is larger, groups no dirty page depends on are dropped
+    size_t checkpoint_bytes = 1 << 20;
+};
+
+enum class WalRecordType : uint8_t
+{
+    // (key, row) inserted into a leaf which did not split
+    LEAF_INSERT = 1,
+    // used prefix of a page changed by a split, a merge or a root change
+    PAGE_IMAGE = 2,
+    // page_id becomes root of the tree
+    SET_ROOT = 3,
+    // page put on the free list, payload is the id of the next free page
+    FREE_PAGE = 4
+};
+
+struct WalRecord
+{
+    WalRecordType type;
+    uint64_t page_id;
+    std::string payload;
+};
+
+/**
+ * @brief all records of one tree operation, recovery applies a group
+ *  completely or not at all
+ */
+struct WalGroup
+{
+    uint64_t lsn = 0;
+    // allocator state of the file after the operation
+    uint64_t num_pages = 0;
+    uint64_t free_head = UINT64_MAX;
+    uint64_t num_free = 0;
+    std::vector<WalRecord> records;
+};
+
+/**
+ * @brief redo log of a BPlusTree stored next to the tree file
+ *  groups are buffered in memory and written with one fdatasync once
+ *  group_commit_size groups are pending or, at an append, the oldest one
+ *  waited group_commit_interval (group commit). there is no timer: a group
+ *  is durable after commit() at the latest. lsn of groups increase by one
+ *  and keep increasing when the log is reset after a checkpoint
+ *
+ *  file layout: [magic, first lsn] frame*
+ *  frame: [payload size, crc32 of payload] payload
+ *  payload: [lsn, num_pages, free_head, num_free, num_records]
+ *      ([type, page_id, size] bytes)*
+ */
+class WriteAheadLog
+{
+public:
+    // mode: 'c' : create an empty log
+    // mode: 'o' : open an existing log, a missing log is created
+    WriteAheadLog(const std::string & path, char mode, const WalOptions & options);
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog & operator=(const WriteAheadLog &) = delete;
+
+    // lsn which will be assigned to the next appended group
+    inline uint64_t next_lsn() const { return lsn_next; }
+
+    // every group with lsn < durable_lsn() has reached disk
+    inline uint64_t durable_lsn() const { return lsn_durable; }
+
+    // lsn of the oldest group kept by the log
+    inline uint64_t first_lsn() const { return frames.empty() ? lsn_next : frames.front().first; }
+
+    // bytes of the log including buffered groups
+    inline size_t size() const { return file_tail + buffer.size(); }
+    inline bool needs_checkpoint() const { return size() >= options.checkpoint_bytes; }
+
+    // buffer the group with lsn = next_lsn(), may trigger a group commit
+    uint64_t append(WalGroup & group);
+
+    // write and sync every buffered group
+    void commit();
+
+    // make sure group lsn is on disk before a page depending on it is written
+    void flush_to(uint64_t lsn);
+
+    // drop all groups, called once every page they describe is on disk
+    void reset();
+
+    // drop groups with lsn < first_lsn, the kept groups are copied into a
+    // new log which replaces the old one atomically
+    void truncate(uint64_t first_lsn);
+
+    // visit durable groups in order, a torn or corrupted tail is cut off
+    void replay(const std::function<void(const WalGroup &)> & apply);
+
+    inline const std::string & get_path() const { return file_path; }
+
+private:
+    void write_header();
+    void open_file(int flags);
+    // replace the log by a copy of the kept frames
+    void rewrite();
+
+    const std::string file_path;
+    const WalOptions options;
+    int file_descriptor;
+
+    uint64_t lsn_next;
+    uint64_t lsn_durable;
+    off_t file_tail; // end of the durable frames
+    // (lsn, file offset) of every frame, buffered frames included
+    std::deque<std::pair<uint64_t, off_t>> frames;
+
+    std::string buffer; // frames not written yet
+    size_t num_pending;
+    std::chrono::steady_clock::time_point first_pending_time;
+};
+
+// crc32 (ieee) of a buffer
+uint32_t crc32(const void * data, size_t size);
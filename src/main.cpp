@@ -30,7 +30,10 @@ void initalize(const string & dbpath)
         mode = 'c';
 
     auto & handler = GlobalVariableHandler::get_instance();
-    handler.set_btree_paramters(UserInfo().get_row_byte(), mode, dbpath);
+    // inserts survive a crash of the shell
+    WalOptions wal_options;
+    wal_options.enabled = true;
+    handler.set_btree_paramters(UserInfo().get_row_byte(), mode, dbpath, 10000, 1000, PagerOptions(), wal_options);
     handler.get_btree();
 }
 
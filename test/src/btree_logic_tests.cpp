@@ -1,10 +1,15 @@
 #include <string>
 #include <vector>
 #include <queue>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <algorithm>
 #include <core/btree.h>
 #include <core/row.h>
 #include <gtest/gtest.h>
 #include <core/parameters.h>
+#include "test_rows.h"
 using namespace std;
 
 struct TreeNode
@@ -35,8 +40,13 @@ struct NaryTree
             btree->pager.allocate_page(page);
         }
 
+        // the empty root leaf is overwritten by a cloned node
+        btree->root->set_root(false);
+
         // foreach node connect it with its child
-        auto visitor = [&btree, this](TreeNode * node) {
+        // leaves are visited in key order and linked to the previous one
+        uint64_t prev_leaf = PAGE_ID_INVALID;
+        auto visitor = [&btree, &prev_leaf, this](TreeNode * node) {
             auto page_id = node->page_id;
             if (!node->isleaf) {
                 auto  btreeNode = make_unique<InternalNode>(
@@ -50,17 +60,6 @@ struct NaryTree
                     auto lchild = node->children[i];
                     auto rchild = node->children[i+1];
                     btreeNode->insert(key, lchild->page_id, rchild->page_id);
-
-                    // set parent of child node
-                    auto lnode = BtreeNode::LoadNodeFrom(
-                        btree->pager.get_page(lchild->page_id)
-                    );
-                    auto rnode = BtreeNode::LoadNodeFrom(
-                        btree->pager.get_page(rchild->page_id)
-                    );
-
-                    lnode->parent() = page_id;
-                    rnode->parent() = page_id;
                 }
 
             } else {
@@ -70,19 +69,21 @@ struct NaryTree
                 );
 
                 for (int i=0; i < node->keys.size(); ++i)
-                {
-                    btreeNode->allocate_cell();
-                    btreeNode->get_key(i) = node->keys[i];
-                }
+                    btreeNode->allocate_cell(node->keys[i]);
+
+                btreeNode->prev_leaf() = prev_leaf;
+                if (prev_leaf != PAGE_ID_INVALID)
+                    LeafNode(btree->pager.get_page(prev_leaf)).next_leaf() = page_id;
+                prev_leaf = page_id;
             }
 
             if (node == this->root)
             {
                 btree->pager.set_root_page(page_id);
+                btree->root_id = page_id;
                 btree->root_page = btree->pager.get_page(page_id);
                 btree->root = BtreeNode::LoadNodeFrom(btree->root_page);
                 btree->root->set_root(true);
-                btree->root->parent() = NODE_PARENT_INVALID;
             }
         };
 
@@ -325,4 +326,732 @@ TEST(btree_logic, interleave_insert_then_select)
     for (int i=0; i < n; ++i)
         EXPECT_EQ(*LeafNode::extract_key(select_result[i]), (uint32_t) i);
     delete btree;
-}
\ No newline at end of file
+}
+TEST(btree_logic, insert_with_small_buffer_pool)
+{
+    string path = "/tmp/insert_with_small_buffer_pool";
+    PagerOptions options;
+    options.pool_pages = 16;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    int n = 2000;
+    insert_rows(btree, n);
+    EXPECT_GT(btree->get_total_page(), options.pool_pages);
+    delete btree;
+
+    // reopen the tree: all pages evicted before close shall be on disk
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+    EXPECT_TRUE(btree->check_valid());
+    for (int key=0; key < n; ++key)
+        EXPECT_TRUE(btree->find(key).is_exist);
+    delete btree;
+}
+
+TEST(btree_logic, insert_with_mmap_pager)
+{
+    string path = "/tmp/insert_with_mmap_pager";
+    PagerOptions options;
+    options.backend = PagerBackend::MMAP;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    int n = 500;
+
+    for (int i=n-1; i >=0; --i) {
+        string name = to_string(i);
+        UserInfo row(i, name.c_str(), name.c_str());
+        btree->insert(i, &row);
+    }
+    delete btree;
+
+    // a file written through the mapping is readable by the buffer pool
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6);
+    EXPECT_TRUE(btree->check_valid());
+    auto select_result = btree->select_cell(0, 1000);
+    EXPECT_EQ(select_result.size(), n);
+    for (int i=0; i < n; ++i)
+        EXPECT_EQ(*LeafNode::extract_key(select_result[i]), (uint32_t) i);
+    delete btree;
+}
+
+TEST(btree_logic, cursor_walks_leaf_chain)
+{
+    string path = "/tmp/cursor_walks_leaf_chain";
+    PagerOptions options;
+    options.pool_pages = 16;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+
+    // empty tree
+    EXPECT_FALSE(btree->seek(0).is_valid());
+    EXPECT_FALSE(btree->seek_reverse(UINT32_MAX).is_valid());
+
+    // even keys only
+    int n = 1000;
+    insert_rows(btree, n, 2);
+    EXPECT_TRUE(btree->check_valid());
+
+    // forward from a missing key, through every leaf
+    int expected = 2 * 101;
+    for (auto cursor = btree->seek(201); cursor.is_valid(); cursor.next()) {
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        UserInfo row;
+        row.deserialize(cursor.value());
+        EXPECT_EQ(row.to_string(), to_string(expected) + "," + to_string(expected) + "," + to_string(expected));
+        expected += 2;
+    }
+    EXPECT_EQ(expected, 2 * n);
+
+    // backward from a present key
+    expected = 600;
+    for (auto cursor = btree->seek_reverse(600); cursor.is_valid(); cursor.prev()) {
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        expected -= 2;
+    }
+    EXPECT_EQ(expected, -2);
+
+    // both directions from one position, the cursor is gone before the tree
+    {
+        auto cursor = btree->seek(1001);
+        cursor.prev();
+        EXPECT_EQ(cursor.key(), 1000);
+        cursor.next();
+        cursor.next();
+        EXPECT_EQ(cursor.key(), 1004);
+    }
+
+    // past the ends
+    EXPECT_FALSE(btree->seek(2 * n).is_valid());
+    EXPECT_EQ(btree->seek_reverse(1).key(), 0);
+    auto select_result = btree->select_cell(10, 20);
+    EXPECT_EQ(select_result.size(), 6);
+    EXPECT_TRUE(btree->select_cell(21, 20).empty());
+    delete btree;
+
+    // links survive a reopen
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->select_cell(0, UINT32_MAX).size(), n);
+    delete btree;
+}
+
+TEST(btree_logic, cursor_streams_tree_larger_than_pool)
+{
+    string path = "/tmp/cursor_streams_tree_larger_than_pool";
+    PagerOptions options;
+    options.pool_pages = 8;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    int n = 3000;
+    insert_rows(btree, n);
+    EXPECT_GT(btree->get_total_page(), 10 * options.pool_pages);
+
+    // every row is read through the pool, one leaf pinned at a time
+    int expected = 0;
+    UserInfo row;
+    for (auto cursor = btree->seek(0); cursor.is_valid(); cursor.next()) {
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        row.deserialize(cursor.value());
+        ASSERT_EQ(row.to_string(), to_string(expected) + "," + to_string(expected) + "," + to_string(expected));
+        expected += 1;
+    }
+    EXPECT_EQ(expected, n);
+
+    // early termination releases the leaf
+    for (auto cursor = btree->seek(100); cursor.is_valid() && cursor.key() < 110; cursor.next())
+        expected += 1;
+    EXPECT_EQ(expected, n + 10);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+}
+
+// rows with keys 0, 2, 4 ... of a bulk load
+static BPlusTree::RowSource even_rows(int n, UserInfo & row)
+{
+    auto i = std::make_shared<int>(0);
+    return [n, i, &row](uint32_t & key, Row *& out) {
+        if (*i == n)
+            return false;
+        key = 2 * (*i)++;
+        string name = to_string(key);
+        row = UserInfo(key, name.c_str(), name.c_str());
+        out = &row;
+        return true;
+    };
+}
+
+TEST(btree_logic, bulk_load)
+{
+    string path = "/tmp/bulk_load";
+    for (int n : {0, 1, 5, 7, 11, 100, 2345})
+    {
+        for (double fill_factor : {1.0, 0.7, 0.5})
+        {
+            PagerOptions options;
+            options.pool_pages = 16;
+            BPlusTree * btree = new BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+            UserInfo row;
+            btree->bulk_load(even_rows(n, row), fill_factor);
+            ASSERT_TRUE(btree->check_valid()) << n << " " << fill_factor;
+
+            int expected = 0;
+            for (auto cursor = btree->seek(0); cursor.is_valid(); cursor.next()) {
+                ASSERT_EQ(cursor.key(), (uint32_t) expected);
+                expected += 2;
+            }
+            EXPECT_EQ(expected, 2 * n);
+
+            // inserts into the loaded tree split full leaves
+            insert_rows(btree, n, 2, 1);
+            EXPECT_TRUE(btree->check_valid());
+            delete btree;
+
+            btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+            EXPECT_TRUE(btree->check_valid());
+            EXPECT_EQ(btree->select_cell(0, UINT32_MAX).size(), 2 * n);
+            delete btree;
+        }
+    }
+
+    // the tree shall be empty and the keys sorted
+    BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6);
+    UserInfo row;
+    btree.bulk_load(even_rows(10, row));
+    EXPECT_THROW(btree.bulk_load(even_rows(10, row)), std::runtime_error);
+
+    BPlusTree unsorted(path + "-unsorted", 'c', UserInfo().get_row_byte(), 4, 6);
+    int calls = 0;
+    auto source = [&calls, &row](uint32_t & key, Row *& out) {
+        key = calls++ == 0 ? 5 : 3;
+        out = &row;
+        return true;
+    };
+    EXPECT_THROW(unsorted.bulk_load(source), std::runtime_error);
+}
+
+TEST(btree_logic, remove)
+{
+    string path = "/tmp/btree_remove";
+    PagerOptions options;
+    options.pool_pages = 16;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    int n = 600;
+    insert_rows(btree, n);
+    auto num_pages = btree->get_total_page();
+
+    EXPECT_EQ(btree->remove(n), BPlusTree::RemoveStatus::FAIL_KEY_NOT_FOUND);
+
+    // remove every key in another order, the tree stays balanced
+    for (int i=0; i < n; ++i) {
+        int key = (i * 104729) % n;
+        ASSERT_EQ(btree->remove(key), BPlusTree::RemoveStatus::SUCCESS) << key;
+        ASSERT_FALSE(btree->find(key).is_exist);
+        EXPECT_EQ(btree->remove(key), BPlusTree::RemoveStatus::FAIL_KEY_NOT_FOUND);
+        if (i % 10 == 0) {
+            ASSERT_TRUE(btree->check_valid()) << i;
+        }
+    }
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_FALSE(btree->seek(0).is_valid());
+
+    // pages of merged nodes are reused
+    insert_rows(btree, n);
+    EXPECT_EQ(btree->get_total_page(), num_pages);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->select_cell(0, UINT32_MAX).size(), n);
+    delete btree;
+}
+
+TEST(btree_logic, remove_range)
+{
+    string path = "/tmp/btree_remove_range";
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6);
+    int n = 2000;
+    insert_rows(btree, n);
+
+    EXPECT_EQ(btree->remove_range(100, 1099), 1000);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->remove_range(50, 1500), 451);
+    EXPECT_EQ(btree->remove_range(3000, 4000), 0);
+    EXPECT_EQ(btree->remove_range(10, 5), 0);
+    EXPECT_TRUE(btree->check_valid());
+
+    int expected = 0;
+    for (auto cursor = btree->seek(0); cursor.is_valid(); cursor.next()) {
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        expected = expected == 49 ? 1501 : expected + 1;
+    }
+    EXPECT_EQ(expected, n);
+
+    // the whole tree collapses into an empty root leaf
+    EXPECT_EQ(btree->remove_range(0, UINT32_MAX), 549);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->get_total_page() - 1, btree->get_num_free_pages());
+    delete btree;
+}
+
+TEST(btree_logic, split_touches_only_changed_nodes)
+{
+    string path = "/tmp/btree_split_touches_only_changed_nodes";
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6);
+    int n = 500;
+
+    // a split changes the node, its new sibling and the next leaf,
+    // children moved to the new sibling are left alone
+    for (int i=0; i < n; ++i) {
+        int key = scrambled_key(i, n);
+        auto num_pages = btree->get_total_page();
+        btree->commit();
+        ASSERT_EQ(btree->get_num_dirty_pages(), 0);
+
+        string name = std::to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key, &row), BPlusTree::InsertStatus::SUCCESS);
+        EXPECT_LE(btree->get_num_dirty_pages(), 2 * (btree->get_total_page() - num_pages) + 2) << key;
+    }
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+}
+
+TEST(btree_logic, uint64_keys)
+{
+    using Tree = BasicBPlusTree<uint64_t>;
+    string path = "/tmp/btree_uint64_keys";
+    Tree * btree = new Tree(path, 'c', UserInfo().get_row_byte(), 4, 6);
+    int n = 2000;
+    // keys differ only above the low 32 bits
+    auto key_of = [](int i) { return ((uint64_t) (i + 1) << 32) + 7; };
+
+    for (int i=0; i < n; ++i) {
+        int id = scrambled_key(i, n);
+        string name = to_string(id);
+        UserInfo row(id, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key_of(id), &row), Tree::InsertStatus::SUCCESS);
+    }
+    UserInfo row(0, "x", "x");
+    EXPECT_EQ(btree->insert(key_of(5), &row), Tree::InsertStatus::FAIL_DUPLICATE_KEY);
+    EXPECT_FALSE(btree->find(7).is_exist);
+    EXPECT_EQ(btree->remove(7), Tree::RemoveStatus::FAIL_KEY_NOT_FOUND);
+    for (int id=1; id < n; id += 2)
+        ASSERT_EQ(btree->remove(key_of(id)), Tree::RemoveStatus::SUCCESS);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+
+    btree = new Tree(path, 'o', UserInfo().get_row_byte(), 4, 6);
+    EXPECT_TRUE(btree->check_valid());
+    for (int id=0; id < n; ++id)
+        EXPECT_EQ(btree->find(key_of(id)).is_exist, id % 2 == 0) << id;
+    int id = 0;
+    for (auto cursor = btree->seek(0); cursor.is_valid(); cursor.next(), id += 2)
+        ASSERT_EQ(cursor.key(), key_of(id));
+    EXPECT_EQ(id, n);
+    delete btree;
+}
+
+TEST(btree_logic, byte_keys)
+{
+    using Tree = BasicBPlusTree<std::string_view>;
+    string path = "/tmp/btree_byte_keys";
+    Tree * btree = new Tree(path, 'c', UserInfo().get_row_byte(), 4, 6);
+    int n = 2000;
+    // long keys sharing a prefix, separators only keep what tells them apart
+    auto key_of = [](int i) {
+        char key[64];
+        snprintf(key, sizeof(key), "tenant/0042/users/by-email/%06d@example.com", i);
+        return string(key);
+    };
+
+    for (int i=0; i < n; ++i) {
+        int id = scrambled_key(i, n);
+        string name = to_string(id);
+        UserInfo row(id, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key_of(id), &row), Tree::InsertStatus::SUCCESS);
+    }
+    UserInfo row(0, "x", "x");
+    EXPECT_EQ(btree->insert(key_of(5), &row), Tree::InsertStatus::FAIL_DUPLICATE_KEY);
+    EXPECT_THROW(btree->insert(string(BYTE_KEY_MAX_SIZE + 1, 'k'), &row), std::runtime_error);
+    EXPECT_TRUE(btree->insert(string(BYTE_KEY_MAX_SIZE, 'k'), &row) == Tree::InsertStatus::SUCCESS);
+    EXPECT_TRUE(btree->check_valid());
+
+    EXPECT_TRUE(btree->find(key_of(1234)).is_exist);
+    EXPECT_FALSE(btree->find("tenant/0042/users").is_exist);
+    {
+        auto cursor = btree->seek(key_of(1234));
+        ASSERT_TRUE(cursor.is_valid());
+        UserInfo found;
+        found.deserialize(cursor.value());
+        EXPECT_EQ(found.get_primary_key(), 1234u);
+    }
+
+    EXPECT_EQ(btree->remove_range(key_of(100), key_of(1099)), 1000);
+    EXPECT_EQ(btree->remove(string(BYTE_KEY_MAX_SIZE, 'k')), Tree::RemoveStatus::SUCCESS);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+
+    btree = new Tree(path, 'o', UserInfo().get_row_byte(), 4, 6);
+    EXPECT_TRUE(btree->check_valid());
+    int id = 0;
+    for (auto cursor = btree->seek(""); cursor.is_valid(); cursor.next()) {
+        ASSERT_EQ(cursor.key(), key_of(id));
+        id = id == 99 ? 1100 : id + 1;
+    }
+    EXPECT_EQ(id, n);
+    delete btree;
+}
+
+TEST(btree_logic, fixed_row_size)
+{
+    string path = "/tmp/btree_fixed_row_size";
+    int n = 2000;
+    EXPECT_THROW(UserInfoBPlusTree(path, 'c', UserInfo::ROW_BYTE + 4, 4, 6), std::runtime_error);
+
+    auto * btree = new UserInfoBPlusTree(path, 'c', UserInfo::ROW_BYTE, 4, 6);
+    insert_rows(btree, n);
+    EXPECT_EQ(btree->remove_range(100, 1099), 1000);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+
+    // the file is the one of a tree with rows sized at runtime
+    BPlusTree * reopened = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6);
+    EXPECT_TRUE(reopened->check_valid());
+    int expected = 0;
+    for (auto cursor = reopened->seek(0); cursor.is_valid(); cursor.next()) {
+        UserInfo row;
+        row.deserialize(cursor.value());
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        ASSERT_EQ(row.get_primary_key(), (uint32_t) expected);
+        expected = expected == 99 ? 1100 : expected + 1;
+    }
+    EXPECT_EQ(expected, n);
+    delete reopened;
+}
+
+TEST(btree_logic, insert_batch)
+{
+    string path = "/tmp/btree_insert_batch";
+    PagerOptions options;
+    options.pool_pages = 64;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    int n = 3000;
+
+    // one batch into the empty tree splits its root leaf into hundreds of
+    // leaves and grows several inner levels at once
+    vector<UserInfo> rows(n);
+    vector<BPlusTree::BatchEntry> batch;
+    for (int key=0; key < n; key += 3) {
+        string name = to_string(key);
+        rows[key] = UserInfo(key, name.c_str(), name.c_str());
+        batch.push_back({(uint32_t) key, &rows[key]});
+    }
+    EXPECT_EQ(btree->insert_batch(batch), 1000);
+    EXPECT_TRUE(btree->check_valid());
+
+    // batches in random order which repeat keys of the tree and of the batch
+    srand(5);
+    for (int round=0; round < 10; ++round) {
+        batch.clear();
+        for (int i=0; i < 400; ++i) {
+            int key = rand() % n;
+            string name = to_string(key);
+            rows[key] = UserInfo(key, name.c_str(), name.c_str());
+            batch.push_back({(uint32_t) key, &rows[key]});
+        }
+        size_t before = btree->select_cell(0, n).size();
+        size_t inserted = btree->insert_batch(batch);
+        ASSERT_EQ(btree->select_cell(0, n).size(), before + inserted);
+        ASSERT_TRUE(btree->check_valid()) << round;
+    }
+    batch.clear();
+    for (int key=0; key < n; ++key) {
+        string name = to_string(key);
+        rows[key] = UserInfo(key, name.c_str(), name.c_str());
+        batch.push_back({(uint32_t) (n - 1 - key), &rows[n - 1 - key]});
+    }
+    btree->insert_batch(batch);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->insert_batch(batch), 0);
+    delete btree;
+
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+    EXPECT_TRUE(btree->check_valid());
+    int expected = 0;
+    for (auto cursor = btree->seek(0); cursor.is_valid(); cursor.next(), ++expected) {
+        UserInfo row;
+        row.deserialize(cursor.value());
+        ASSERT_EQ(cursor.key(), (uint32_t) expected);
+        ASSERT_EQ(row.get_primary_key(), (uint32_t) expected);
+    }
+    EXPECT_EQ(expected, n);
+    for (auto cursor = btree->seek_reverse(n); cursor.is_valid(); cursor.prev())
+        --expected;
+    EXPECT_EQ(expected, 0);
+    delete btree;
+}
+
+TEST(btree_logic, sequential_inserts_fill_leaves)
+{
+    string path = "/tmp/btree_sequential_inserts_fill_leaves";
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 50, 20);
+    int n = 10000;
+
+    // appends split the last leaf 90/10, the leaves left behind are nearly full
+    for (int key=0; key < n; ++key) {
+        string name = to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key, &row), BPlusTree::InsertStatus::SUCCESS);
+    }
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_LT(btree->get_total_page(), n / 40);
+
+    // removes and inserts before the last key move the right edge, appends
+    // after them take a new path
+    EXPECT_EQ(btree->remove_range(n - 300, n - 1), 300);
+    for (int key=n - 300; key < n + 500; ++key) {
+        string name = to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key, &row), BPlusTree::InsertStatus::SUCCESS);
+        if (key % 7 == 0) {
+            ASSERT_EQ(btree->remove(key / 2), BPlusTree::RemoveStatus::SUCCESS);
+            ASSERT_EQ(btree->insert(key / 2, &row), BPlusTree::InsertStatus::SUCCESS);
+        }
+    }
+    UserInfo row(0, "0", "0");
+    EXPECT_EQ(btree->insert(n + 499, &row), BPlusTree::InsertStatus::FAIL_DUPLICATE_KEY);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 50, 20);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->select_cell(0, UINT32_MAX).size(), n + 500);
+    delete btree;
+}
+
+TEST(btree_logic, loads_above_capacity)
+{
+    // loads above the capacity of a node are capped by it, as in the repl
+    string path = "/tmp/btree_loads_above_capacity";
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 1000, 1000);
+    int n = 100000;
+    insert_rows(btree, n);
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->remove_range(0, n / 2), n / 2 + 1);
+    EXPECT_TRUE(btree->check_valid());
+    delete btree;
+}
+
+TEST(btree_logic, multi_find)
+{
+    // a pool of 8 frames leaves little room for the nodes pinned by prefetch
+    for (size_t pool_pages : {16, 8}) {
+        string path = "/tmp/btree_multi_find";
+        PagerOptions options;
+        options.pool_pages = pool_pages;
+        BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+        EXPECT_TRUE(btree->multi_find({}).empty());
+        EXPECT_FALSE(btree->multi_find({3})[0].is_exist);
+
+        // even keys, the tree is larger than the pool
+        int n = 3000;
+        insert_rows(btree, n, 2);
+
+        // scattered probes with hits, misses, repeats and keys past either end
+        srand(11);
+        for (size_t size : {1, 7, 100, 5000}) {
+            vector<uint32_t> keys;
+            for (size_t i=0; i < size; ++i)
+                keys.push_back(rand() % (2 * n + 10));
+            keys.push_back(keys[0]);
+            keys.push_back(UINT32_MAX);
+
+            auto locations = btree->multi_find(keys);
+            ASSERT_EQ(locations.size(), keys.size());
+            for (size_t i=0; i < keys.size(); ++i) {
+                auto expected = btree->find(keys[i]);
+                ASSERT_EQ(locations[i].is_exist, expected.is_exist) << keys[i];
+                ASSERT_EQ(locations[i].page_id, expected.page_id) << keys[i];
+                ASSERT_EQ(locations[i].row_id, expected.row_id) << keys[i];
+            }
+        }
+        delete btree;
+    }
+}
+
+TEST(btree_logic, find_row_and_scan)
+{
+    string path = "/tmp/btree_find_row_and_scan";
+    PagerOptions options;
+    options.pool_pages = 16;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+    char buffer[UserInfo::ROW_BYTE];
+    EXPECT_FALSE(btree->find_row(3, buffer));
+    EXPECT_EQ(btree->scan(0, UINT32_MAX, [](uint32_t, const void *) { return true; }), 0);
+
+    // even keys, the tree is larger than the pool
+    int n = 3000;
+    insert_rows(btree, n, 2);
+
+    for (int key=0; key < 2 * n; ++key) {
+        ASSERT_EQ(btree->find_row(key, buffer), key % 2 == 0) << key;
+        if (key % 2 == 0) {
+            UserInfo row;
+            row.deserialize(buffer);
+            ASSERT_EQ(row.get_primary_key(), (uint32_t)key);
+        }
+    }
+
+    // rows come in key order with the rows of their keys
+    vector<uint32_t> keys;
+    auto collect = [&](uint32_t key, const void * cell) {
+        UserInfo row;
+        row.deserialize((void *)cell);
+        EXPECT_EQ(row.get_primary_key(), key);
+        keys.push_back(key);
+        return true;
+    };
+    EXPECT_EQ(btree->scan(101, 2001, collect), 950);
+    for (size_t i=0; i < keys.size(); ++i)
+        ASSERT_EQ(keys[i], 102 + 2 * i);
+
+    // the largest key ends the scan, a visitor stops it
+    keys.clear();
+    EXPECT_EQ(btree->scan(0, UINT32_MAX, collect), n);
+    EXPECT_EQ(keys.back(), (uint32_t)(2 * n - 2));
+    EXPECT_EQ(btree->scan(10, 20, [](uint32_t key, const void *) { return key < 14; }), 3);
+    delete btree;
+}
+
+TEST(btree_logic, readers_during_changes)
+{
+    string path = "/tmp/btree_readers_during_changes";
+    PagerOptions options;
+    options.backend = PagerBackend::MMAP;
+    BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+
+    // the writer inserts keys in a scrambled order then removes the odd
+    // ones, splits, borrows and merges run below the readers. a published
+    // even key stays in the tree
+    int n = 20000;
+    vector<uint32_t> order(n);
+    for (int i=0; i < n; ++i)
+        order[i] = scrambled_key(i, n);
+    atomic<int> published(0);
+    atomic<bool> done(false);
+
+    thread writer([&]() {
+        for (int i=0; i < n; ++i) {
+            string name = to_string(order[i]);
+            UserInfo row(order[i], name.c_str(), name.c_str());
+            btree->insert(order[i], &row);
+            published.store(i + 1);
+        }
+        for (int i=0; i < n; ++i)
+            if (order[i] % 2 == 1)
+                btree->remove(order[i]);
+        done.store(true);
+    });
+
+    auto point_reader = [&](unsigned seed) {
+        char buffer[UserInfo::ROW_BYTE];
+        while (!done.load()) {
+            int p = published.load();
+            if (p == 0)
+                continue;
+            uint32_t key = order[rand_r(&seed) % p];
+            if (key % 2 == 1)
+                continue;
+            ASSERT_TRUE(btree->find_row(key, buffer)) << key;
+            UserInfo row;
+            row.deserialize(buffer);
+            ASSERT_EQ(row.get_primary_key(), key);
+            ASSERT_TRUE(btree->find(key).is_exist) << key;
+        }
+    };
+
+    auto scan_reader = [&]() {
+        while (!done.load()) {
+            int p = published.load();
+            int published_even = 0;
+            for (int i=0; i < p; ++i)
+                published_even += order[i] % 2 == 0;
+
+            int64_t last = -1;
+            int even = 0;
+            btree->scan(0, UINT32_MAX, [&](uint32_t key, const void * cell) {
+                UserInfo row;
+                row.deserialize((void *)cell);
+                EXPECT_EQ(row.get_primary_key(), key);
+                EXPECT_GT((int64_t)key, last);
+                last = key;
+                even += key % 2 == 0;
+                return true;
+            });
+            ASSERT_GE(even, published_even);
+        }
+    };
+
+    thread readers[] = {thread(point_reader, 1), thread(point_reader, 2), thread(scan_reader)};
+    writer.join();
+    for (auto & reader : readers)
+        reader.join();
+
+    EXPECT_TRUE(btree->check_valid());
+    EXPECT_EQ(btree->scan(0, UINT32_MAX, [](uint32_t key, const void *) { return key % 2 == 0; }), n / 2);
+    delete btree;
+}
+
+TEST(btree_logic, parallel_scan)
+{
+    WorkStealingPool pool(4);
+    for (auto backend : {PagerBackend::MMAP, PagerBackend::BUFFER_POOL}) {
+        string path = "/tmp/btree_parallel_scan";
+        PagerOptions options;
+        options.backend = backend;
+        BPlusTree * btree = new  BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+        EXPECT_EQ(btree->parallel_scan(0, UINT32_MAX, pool, true, [](unsigned, uint32_t, const void *) { return true; }), 0);
+
+        // even keys, small nodes give many levels to cut the range at
+        int n = 5000;
+        insert_rows(btree, n, 2);
+
+        // ordered: one row at a time in key order
+        vector<uint32_t> keys;
+        auto collect = [&](unsigned, uint32_t key, const void * cell) {
+            UserInfo row;
+            row.deserialize((void *)cell);
+            EXPECT_EQ(row.get_primary_key(), key);
+            keys.push_back(key);
+            return true;
+        };
+        EXPECT_EQ(btree->parallel_scan(0, UINT32_MAX, pool, true, collect), n);
+        ASSERT_EQ(keys.size(), n);
+        for (int i=0; i < n; ++i)
+            ASSERT_EQ(keys[i], (uint32_t)(2 * i));
+
+        keys.clear();
+        EXPECT_EQ(btree->parallel_scan(101, 2001, pool, true, collect), 950);
+        EXPECT_EQ(keys.front(), 102);
+        EXPECT_EQ(keys.back(), 2000);
+        EXPECT_TRUE(is_sorted(keys.begin(), keys.end()));
+        EXPECT_EQ(btree->parallel_scan(10, 20, pool, true, [](unsigned, uint32_t key, const void *) { return key < 14; }), 3);
+        EXPECT_EQ(btree->parallel_scan(21, 20, pool, true, collect), 0);
+
+        // unordered: partial sums of the threads add up to the total
+        vector<uint64_t> sums(pool.num_threads()), counts(pool.num_threads());
+        size_t visited = btree->parallel_scan(1, 2 * n, pool, false, [&](unsigned worker, uint32_t key, const void *) {
+            sums[worker] += key;
+            counts[worker] += 1;
+            return true;
+        });
+        EXPECT_EQ(visited, n - 1);
+        EXPECT_EQ(accumulate(counts.begin(), counts.end(), (uint64_t)0), n - 1);
+        EXPECT_EQ(accumulate(sums.begin(), sums.end(), (uint64_t)0), (uint64_t)n * (n - 1));
+
+        // a stop ends every thread early
+        atomic<size_t> until_stop(0);
+        visited = btree->parallel_scan(0, UINT32_MAX, pool, false, [&](unsigned, uint32_t, const void *) {
+            return ++until_stop < 100;
+        });
+        EXPECT_GE(visited, 100);
+        EXPECT_LT(visited, n);
+        delete btree;
+    }
+}
@@ -13,8 +13,7 @@ TEST(btree_node, use_leaf_node)
 
     for (int i = 0; i < lnode.num_max_cell; ++i)
     {
-        void * cell = lnode.allocate_cell();
-        *LeafNode::extract_key(cell) = i;
+        void * cell = lnode.allocate_cell(i);
         user.serialize(LeafNode::extract_value(cell));
         // lnode.num_cells() += 1;
     }
@@ -40,8 +39,7 @@ TEST(btree_node, check_duplicate)
     for (int i = 0; i < n; ++i)
     {
         UserInfo user(i);
-        void * cell = lnode.allocate_cell();
-        *LeafNode::extract_key(cell) = i;
+        void * cell = lnode.allocate_cell(i);
         user.serialize(LeafNode::extract_value(cell));
     }
 
@@ -111,7 +109,8 @@ TEST(btree_node, insert_full_leaf_node)
 
         // allocate a new page and insert the skip
         UserInfo last(skip, std::to_string(skip).c_str(), std::to_string(skip).c_str());
-        uint32_t pivot = lnode.insert_and_split(skip, &last, rpage);
+        lnode.next_leaf() = 7;
+        uint32_t pivot = lnode.insert_and_split(skip, &last, rpage, 3, 5);
         EXPECT_EQ(pivot, lnode.num_max_cell / 2);
 
         for (int i = 0; i < lnode.num_cells(); ++i)
@@ -122,7 +121,11 @@ TEST(btree_node, insert_full_leaf_node)
             EXPECT_TRUE(std::to_string(i) + "," + std::to_string(i) + "," + std::to_string(i) == ui.to_string());
         }
 
+        // the new leaf is linked between the node and its old right sibling
         LeafNode rnode(rpage);
+        EXPECT_EQ(lnode.next_leaf(), 5);
+        EXPECT_EQ(rnode.prev_leaf(), 3);
+        EXPECT_EQ(rnode.next_leaf(), 7);
         EXPECT_EQ(rnode.num_cells() + 1, lnode.num_cells());
         for (int i = 0; i < rnode.num_cells(); ++i)
         {
@@ -259,10 +262,7 @@ TEST(btree_node, contain_duplicate)
 
     BtreeNode * node = new LeafNode(page, 10);
     for (int i = 0; i < 10; ++i)
-    {
-        ((LeafNode *)node)->allocate_cell();
-        node->get_key(i) = i;
-    }
+        ((LeafNode *)node)->allocate_cell(i);
     EXPECT_FALSE(node->contain_duplicate());
 
     node->get_key(5) = 4;
@@ -270,4 +270,155 @@ TEST(btree_node, contain_duplicate)
     EXPECT_TRUE(node->contain_duplicate());
 
     free(page);
-}
\ No newline at end of file
+}
+TEST(btree_node, slotted_leaf_reuses_heap)
+{
+    void * page = malloc(PAGE_SIZE);
+    LeafNode lnode(page, UserInfo().get_row_byte());
+    int n = lnode.num_max_cell;
+    for (int i = 0; i < n; ++i)
+    {
+        UserInfo user(2 * i, std::to_string(2 * i).c_str(), "");
+        lnode.insert(2 * i, &user);
+    }
+
+    // removes and reinserts until every heap slot was handed out many times,
+    // the compaction keeps each row with its key
+    for (int round = 0; round < 5 * n; ++round)
+    {
+        uint32_t pos = (round * 7) % n;
+        uint32_t key = lnode.get_key(pos);
+        lnode.remove_cells(pos, 1);
+        uint32_t new_key = key % 2 == 0 ? key + 1 : key - 1;
+        UserInfo user(new_key, std::to_string(new_key).c_str(), "");
+        lnode.insert(new_key, &user);
+    }
+
+    ASSERT_EQ(lnode.num_cells(), n);
+    EXPECT_FALSE(lnode.contain_duplicate());
+    UserInfo user;
+    for (int i = 0; i < n; ++i)
+    {
+        if (i > 0)
+            EXPECT_LT(lnode.get_key(i - 1), lnode.get_key(i));
+        EXPECT_EQ(*LeafNode::extract_key(lnode.get_cell(i)), lnode.get_key(i));
+        user.deserialize(lnode.get_value(i));
+        EXPECT_EQ(user.to_string(), std::to_string(lnode.get_key(i)) + "," + std::to_string(lnode.get_key(i)) + ",");
+    }
+
+    free(page);
+}
+
+TEST(btree_node, byte_key_separator)
+{
+    using Traits = KeyTraits<std::string_view>;
+    srand(17);
+    // a small alphabet makes long common prefixes
+    auto random_key = []() {
+        std::string key(rand() % 12, 'a');
+        for (char & c : key)
+            c = "ab\x01\xff"[rand() % 4];
+        return key;
+    };
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        std::string left = random_key(), right = random_key();
+        if (left == right)
+            continue;
+        if (right < left)
+            std::swap(left, right);
+
+        // left <= s < right and no shorter prefix of s separates
+        std::string s = Traits::separator(left, right);
+        ASSERT_LE(left, s) << left << " " << right;
+        ASSERT_LT(s, right) << left << " " << right;
+        ASSERT_LE(s.size(), left.size() + 1);
+        for (size_t len = 0; len < s.size(); ++len)
+            ASSERT_LT(s.substr(0, len), left) << left << " " << right;
+    }
+    EXPECT_EQ(Traits::separator("user:000123", "user:000200"), "user:0002");
+    EXPECT_EQ(Traits::separator("user:1", "user:10"), "user:1");
+    EXPECT_EQ(Traits::separator("user:1a", "user:3"), "user:2");
+    EXPECT_EQ(Traits::separator("user:1a", "user:2"), "user:1a");
+}
+
+TEST(btree_node, fixed_row_leaf_matches_dynamic)
+{
+    using FixedLeaf = BasicLeafNode<uint32_t, UserInfo::ROW_BYTE>;
+    static_assert(FixedLeaf::capacity == 50 && FixedLeaf::cell_size == 72, "layout of UserInfo leaves");
+
+    // both kinds of leaves lay out a page the same way
+    void * page = malloc(PAGE_SIZE);
+    void * new_page = malloc(PAGE_SIZE);
+    FixedLeaf fixed(page, UserInfo::ROW_BYTE);
+    LeafNode dynamic(page);
+    EXPECT_EQ(dynamic.row_size, fixed.row_size);
+    EXPECT_EQ(dynamic.capacity, fixed.capacity);
+    EXPECT_EQ(dynamic.used_bytes(), fixed.used_bytes());
+
+    for (uint32_t i = 0; i < fixed.num_max_cell; ++i)
+    {
+        std::string name = std::to_string(2 * i);
+        UserInfo row(2 * i, name.c_str(), name.c_str());
+        fixed.insert(2 * i, &row);
+    }
+    UserInfo row(7, "7", "7");
+    uint32_t pivot = fixed.insert_and_split(7, &row, new_page, 1, 2);
+    EXPECT_EQ(pivot, 48u);
+
+    LeafNode left(page), right(new_page);
+    EXPECT_EQ(left.num_cells() + right.num_cells(), FixedLeaf::capacity + 1);
+    EXPECT_EQ(left.get_key(4), 7u);
+    for (uint32_t i = 0; i < right.num_cells(); ++i)
+    {
+        UserInfo cell;
+        cell.deserialize(right.get_value(i));
+        EXPECT_EQ(cell.get_primary_key(), right.get_key(i));
+    }
+    EXPECT_EQ(FixedLeaf(new_page).used_bytes(), right.used_bytes());
+    free(page);
+    free(new_page);
+}
+
+TEST(btree_node, append_split_keeps_most_keys)
+{
+    void * page = malloc(PAGE_SIZE);
+    void * new_page = malloc(PAGE_SIZE);
+
+    // a key past the last one of a full last leaf: 46 cells stay, 5 go right
+    LeafNode leaf(page, UserInfo().get_row_byte());
+    uint32_t n = leaf.num_max_cell;
+    for (uint32_t i = 0; i < n; ++i)
+    {
+        UserInfo row(i, "a", "a");
+        leaf.insert(i, &row);
+    }
+    UserInfo last(n, "b", "b");
+    uint32_t pivot = leaf.insert_and_split(n, &last, new_page, 1, 2, true);
+    LeafNode right(new_page);
+    EXPECT_EQ(leaf.num_cells(), n + 1 - (n + 1) / 10);
+    EXPECT_EQ(right.num_cells(), (n + 1) / 10);
+    EXPECT_EQ(pivot, leaf.num_cells() - 1);
+    EXPECT_EQ(right.get_key(right.num_cells() - 1), n);
+    EXPECT_EQ(right.prev_leaf(), 1);
+
+    // a full last inner node keeps all but one key when the load is small
+    InternalNode inner(page, true);
+    inner.set_node_load(6);
+    inner.get_child(0) = 100;
+    for (uint32_t i = 0; i < 6; ++i)
+        inner.append(10 * (i + 1), 101 + i);
+    pivot = inner.insert_and_split(70, 106, 107, new_page, true);
+    InternalNode rinner(new_page);
+    EXPECT_EQ(pivot, 60);
+    EXPECT_EQ(inner.num_keys(), 5);
+    EXPECT_EQ(inner.get_child(5), 105);
+    EXPECT_EQ(rinner.num_keys(), 1);
+    EXPECT_EQ(rinner.get_key(0), 70);
+    EXPECT_EQ(rinner.get_child(0), 106);
+    EXPECT_EQ(rinner.get_child(1), 107);
+
+    free(new_page);
+    free(page);
+}
@@ -1,5 +1,6 @@
 #include "core/parameters.h"
 #include <core/dbfile.h>
+#include <cstring>
 #include <gtest/gtest.h>
 #include <sys/fcntl.h>
 #include <unistd.h>
@@ -71,4 +72,138 @@ TEST(btreepager, write_page) {
         EXPECT_EQ(p6[i], 'c');
     }
     delete pager2;
-}
\ No newline at end of file
+}
+
+TEST(btreepager, mmap_write_page) {
+    PagerOptions options;
+    options.backend = PagerBackend::MMAP;
+    BTreePager *pager = new BTreePager("/tmp/mmap_write_page", 'c', options);
+
+    void * first;
+    pager->allocate_page(first);
+    memset(first, 'a', PAGE_SIZE);
+
+    // growing the file shall not move pages already handed out
+    for (int i=1; i < 300; ++i) {
+        void * page;
+        pager->allocate_page(page);
+        memset(page, 'a' + i % 26, PAGE_SIZE);
+    }
+    EXPECT_EQ(pager->get_page(0), first);
+    delete pager;
+
+    // the buffered pager reads what was written to the mapping
+    BTreePager *pager2 = new BTreePager("/tmp/mmap_write_page", 'o');
+    EXPECT_EQ(pager2->num_pages(), 300);
+    for (int i=0; i < 300; ++i) {
+        char * page = (char *) pager2->get_page(i);
+        EXPECT_EQ(page[0], 'a' + i % 26);
+        EXPECT_EQ(page[PAGE_SIZE - 1], 'a' + i % 26);
+    }
+    delete pager2;
+
+    struct stat buf;
+    stat("/tmp/mmap_write_page", &buf);
+    EXPECT_EQ(buf.st_size, BtreeMetaData::page_offset(300));
+}
+
+TEST(btreepager, free_list) {
+    std::string path = "/tmp/free_list";
+    BTreePager * pager = new BTreePager(path, 'c');
+    for (int i = 0; i < 6; ++i) {
+        void * page;
+        pager->allocate_page(page);
+        memset(page, 'a' + i, PAGE_SIZE);
+    }
+    pager->free_page(2);
+    pager->free_page(4);
+    EXPECT_EQ(pager->num_free_pages(), 2);
+
+    // meta data on disk only changes when the pager syncs
+    int fd = open(path.c_str(), O_RDONLY);
+    BtreeMetaData on_disk(path, fd);
+    pager->sync_to_disk();
+    on_disk.load_from_disk();
+    EXPECT_EQ(on_disk.num_pages, 6);
+    EXPECT_EQ(on_disk.free_head, 4);
+    EXPECT_EQ(on_disk.num_free, 2);
+    close(fd);
+    delete pager;
+
+    // freed pages are reused last freed first, then the file grows
+    pager = new BTreePager(path, 'o');
+    void * page;
+    EXPECT_EQ(pager->allocate_page(page), 4);
+    EXPECT_EQ(((char *)page)[PAGE_SIZE - 1], 0);
+    EXPECT_EQ(pager->allocate_page(page), 2);
+    EXPECT_EQ(pager->free_list_head(), PAGE_ID_INVALID);
+    EXPECT_EQ(pager->allocate_page(page), 6);
+    EXPECT_EQ(pager->num_pages(), 7);
+    EXPECT_EQ(((char *)pager->get_page(5))[0], 'f');
+    delete pager;
+}
+
+TEST(btreepager, direct_io) {
+    std::string path = "/tmp/direct_io";
+    PagerOptions options;
+    options.direct_io = true;
+    options.pool_pages = 8;
+
+    // more pages than frames: pages go through aligned direct writes
+    BTreePager * pager = new BTreePager(path, 'c', options);
+    for (int i = 0; i < 40; ++i) {
+        void * page;
+        pager->allocate_page(page);
+        EXPECT_EQ((uintptr_t)page % PAGE_SIZE, 0);
+        memset(page, 'a' + i % 26, PAGE_SIZE);
+    }
+    printf("direct io: %d\n", pager->is_direct_io());
+    delete pager;
+
+    // every data page starts at a block boundary after the header page
+    struct stat buf;
+    stat(path.c_str(), &buf);
+    EXPECT_EQ(buf.st_size, 41 * PAGE_SIZE);
+
+    pager = new BTreePager(path, 'o');
+    EXPECT_EQ(pager->num_pages(), 40);
+    for (int i = 0; i < 40; ++i) {
+        char * page = (char *)pager->get_page(i);
+        EXPECT_EQ(page[0], 'a' + i % 26);
+        EXPECT_EQ(page[PAGE_SIZE - 1], 'a' + i % 26);
+    }
+    delete pager;
+}
+
+TEST(btreepager, readahead) {
+    std::string path = "/tmp/readahead";
+    BTreePager * pager = new BTreePager(path, 'c');
+    for (int i = 0; i < 200; ++i) {
+        void * page;
+        pager->allocate_page(page);
+        memset(page, 'a' + i % 26, PAGE_SIZE);
+    }
+    delete pager;
+
+    for (auto engine : {IoEngine::SYNC, IoEngine::ASYNC}) {
+        PagerOptions options;
+        options.io_engine = engine;
+        options.pool_pages = 64;
+        options.readahead_pages = 16;
+        pager = new BTreePager(path, 'o', options);
+
+        // a sequential scan loads pages ahead of the reader
+        for (int i = 0; i < 200; ++i) {
+            char * page = (char *)pager->get_page(i);
+            EXPECT_EQ(page[0], 'a' + i % 26);
+            EXPECT_EQ(page[PAGE_SIZE - 1], 'a' + i % 26);
+            if (engine == IoEngine::ASYNC && i == 20)
+                EXPECT_GT(pager->num_resident_pages(), 21);
+        }
+
+        // explicit prefetch of scattered pages
+        pager->prefetch({3, 150, 77, 3, 500});
+        EXPECT_EQ(((char *)pager->get_page(77))[0], 'a' + 77 % 26);
+        delete pager;
+    }
+}
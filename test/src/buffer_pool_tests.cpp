@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <core/buffer_pool.h>
+#include <core/dbfile.h>
+#include <core/parameters.h>
+#include <gtest/gtest.h>
+
+// in memory disk used to observe page io of the pool
+struct FakeDisk
+{
+    std::map<uint64_t, std::string> pages;
+    int num_reads = 0;
+    int num_writes = 0;
+
+    BufferPool::PageReader reader()
+    {
+        return [this](uint64_t page_id, void * frame)
+        {
+            num_reads += 1;
+            memcpy(frame, pages[page_id].data(), PAGE_SIZE);
+        };
+    }
+
+    BufferPool::PageWriter writer()
+    {
+        return [this](uint64_t page_id, const void * frame)
+        {
+            num_writes += 1;
+            pages[page_id] = std::string((const char *)frame, PAGE_SIZE);
+        };
+    }
+};
+
+TEST(buffer_pool, evict_writes_back_dirty_page)
+{
+    FakeDisk disk;
+    BufferPool pool(2, disk.reader(), disk.writer());
+
+    for (uint64_t pid = 0; pid < 4; ++pid)
+    {
+        char * page = (char *)pool.create(pid);
+        memset(page, 'a' + pid, PAGE_SIZE);
+    }
+
+    // only two frames: page 0 and 1 have been written back
+    EXPECT_EQ(pool.num_resident(), 2);
+    EXPECT_EQ(disk.num_writes, 2);
+
+    for (uint64_t pid = 0; pid < 4; ++pid)
+    {
+        char * page = (char *)pool.fetch(pid);
+        for (int i = 0; i < PAGE_SIZE; ++i)
+            EXPECT_EQ(page[i], (char)('a' + pid));
+    }
+
+    // clean pages are not written back
+    int writes = disk.num_writes;
+    pool.fetch(0);
+    pool.fetch(1);
+    pool.mark_dirty(1);
+    pool.flush_all();
+    EXPECT_EQ(disk.num_writes, writes + 1);
+}
+
+TEST(buffer_pool, pinned_page_stays_resident)
+{
+    FakeDisk disk;
+    BufferPool pool(3, disk.reader(), disk.writer());
+
+    void * pinned = pool.create(0);
+    pool.pin(0);
+    memset(pinned, 'p', PAGE_SIZE);
+
+    for (uint64_t pid = 1; pid < 20; ++pid)
+        pool.create(pid);
+
+    EXPECT_TRUE(pool.is_resident(0));
+    EXPECT_EQ(pool.fetch(0), pinned);
+    EXPECT_EQ(((char *)pinned)[PAGE_SIZE - 1], 'p');
+    pool.unpin(0);
+}
+
+TEST(buffer_pool, pager_with_small_pool)
+{
+    size_t n = 64;
+    PagerOptions options;
+    options.pool_pages = 4;
+    BTreePager * pager = new BTreePager("/tmp/pager_with_small_pool", 'c', options);
+    for (size_t i = 0; i < n; ++i)
+    {
+        void * page;
+        pager->allocate_page(page);
+        memset(page, (char)i, PAGE_SIZE);
+        EXPECT_LE(pager->num_resident_pages(), 4);
+    }
+    delete pager;
+
+    pager = new BTreePager("/tmp/pager_with_small_pool", 'o', options);
+    EXPECT_EQ(pager->num_pages(), n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        char * page = (char *)pager->get_page(n - 1 - i);
+        EXPECT_EQ(page[0], (char)(n - 1 - i));
+        EXPECT_EQ(page[PAGE_SIZE - 1], (char)(n - 1 - i));
+    }
+    EXPECT_LE(pager->num_resident_pages(), 4);
+    delete pager;
+}
+
+TEST(buffer_pool, flush_some_sweeps_dirty_pages)
+{
+    FakeDisk disk;
+    BufferPool pool(16, disk.reader(), disk.writer());
+    for (uint64_t pid = 0; pid < 10; ++pid)
+        pool.create(pid);
+    pool.flush_all();
+    EXPECT_EQ(pool.num_dirty(), 0);
+
+    // pages 2 .. 9 dirty, changes from lsn 5 on are not durable in the log
+    for (uint64_t pid = 9; pid >= 2; --pid)
+        pool.mark_dirty(pid, pid);
+    EXPECT_EQ(pool.oldest_dirty_lsn(), 2);
+
+    std::vector<uint64_t> written;
+    pool.set_batch_io(nullptr, [&written](const BufferPool::PageBatch & pages) {
+        for (auto & page : pages)
+            written.push_back(page.first);
+    });
+
+    EXPECT_EQ(pool.flush_some(3, 5), 3);
+    EXPECT_EQ(written, std::vector<uint64_t>({2, 3, 4}));
+    EXPECT_EQ(pool.oldest_dirty_lsn(), 5);
+
+    // the sweep continues after page 4 and wraps around
+    written.clear();
+    pool.mark_dirty(0, 1);
+    EXPECT_EQ(pool.flush_some(3, 5), 1);
+    EXPECT_EQ(written, std::vector<uint64_t>({0}));
+
+    written.clear();
+    EXPECT_EQ(pool.flush_some(10), 5);
+    EXPECT_EQ(written, std::vector<uint64_t>({5, 6, 7, 8, 9}));
+    EXPECT_EQ(pool.num_dirty(), 0);
+    EXPECT_EQ(pool.oldest_dirty_lsn(), UINT64_MAX);
+}
+
+TEST(buffer_pool, frames_come_from_one_arena)
+{
+    PageArena arena(4);
+    void * first = arena.allocate();
+    void * second = arena.allocate();
+    EXPECT_EQ((char *)second - (char *)first, PAGE_SIZE);
+    EXPECT_EQ((uintptr_t)first % PAGE_SIZE, 0);
+
+    // a released frame is handed out again
+    arena.release(first);
+    EXPECT_EQ(arena.num_allocated(), 1);
+    EXPECT_EQ(arena.allocate(), first);
+
+    // huge pages round the region up to whole huge pages
+    PageArena huge(100, HugePages::EXPLICIT);
+    printf("huge pages: %d\n", (int)huge.huge_pages());
+    EXPECT_EQ(huge.reserved_bytes() % (2 << 20), 0);
+    EXPECT_EQ(((uintptr_t)huge.allocate()) % PAGE_SIZE, 0);
+
+    // every page of the pool lives in its region
+    FakeDisk disk;
+    BufferPool pool(8, disk.reader(), disk.writer(), HugePages::TRANSPARENT);
+    EXPECT_GE(pool.memory_bytes(), 8 * PAGE_SIZE);
+    char * low = nullptr, * high = nullptr;
+    for (uint64_t pid = 0; pid < 20; ++pid)
+    {
+        char * page = (char *)pool.create(pid);
+        low = low == nullptr ? page : std::min(low, page);
+        high = std::max(high, page);
+    }
+    EXPECT_LT(high - low, 8 * PAGE_SIZE);
+}
@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <core/key_search.h>
+#include <gtest/gtest.h>
+
+// sorted distinct keys around the sign bit of Int, which catch signed compares
+template <typename Int>
+static std::vector<Int> random_keys(std::mt19937_64 & rng, uint32_t n)
+{
+    const Int sign = (Int)1 << (sizeof(Int) * 8 - 1);
+    std::vector<Int> keys(n);
+    for (auto & key : keys)
+        key = rng() % 4 == 0 ? sign + rng() % 64 : rng() % 1024;
+    keys.push_back(~(Int)0);
+    keys.push_back(0);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+template <typename Int>
+static void check_lower_bound(KeySearchIsa isa, const std::vector<Int> & keys)
+{
+    const Int sign = (Int)1 << (sizeof(Int) * 8 - 1);
+    std::vector<Int> queries = {0, 1, ~(Int)0, sign, (Int)(sign - 1)};
+    for (auto key : keys)
+    {
+        queries.push_back(key);
+        queries.push_back(key + 1);
+    }
+    for (auto query : queries)
+    {
+        uint32_t expected = std::lower_bound(keys.begin(), keys.end(), query) - keys.begin();
+        ASSERT_EQ(lower_bound_keys(keys.data(), keys.size(), query), expected) << key_search_isa_name(isa) << " " << query;
+    }
+}
+
+// every implementation the cpu supports agrees with std::lower_bound
+TEST(key_search, matches_std_lower_bound)
+{
+    std::mt19937_64 rng(7);
+    auto saved = key_search_isa();
+    for (auto isa : {KeySearchIsa::SCALAR, KeySearchIsa::SSE42, KeySearchIsa::AVX2})
+    {
+        if (!set_key_search_isa(isa))
+            continue;
+
+        for (uint32_t n : {0u, 1u, 3u, 8u, 17u, 33u, 56u, 252u, 338u})
+        {
+            check_lower_bound(isa, random_keys<uint32_t>(rng, n));
+            check_lower_bound(isa, random_keys<uint64_t>(rng, n));
+        }
+    }
+    EXPECT_TRUE(set_key_search_isa(saved));
+}
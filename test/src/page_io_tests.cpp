@@ -0,0 +1,117 @@
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <core/btree.h>
+#include <core/dbfile.h>
+#include <core/page_io.h>
+#include <core/parameters.h>
+#include <core/row.h>
+#include <gtest/gtest.h>
+#include "test_rows.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// write n pages with one batch then read them back in reverse order
+static void write_then_read_batch(AsyncPageIO & engine, int n)
+{
+    std::vector<std::string> pages(n);
+    std::vector<PageRequest> requests(n);
+    for (int i = 0; i < n; ++i)
+    {
+        pages[i] = std::string(PAGE_SIZE, 'a' + i % 26);
+        requests[i].type = PageRequest::Type::WRITE;
+        requests[i].buffer = &pages[i][0];
+        requests[i].length = PAGE_SIZE;
+        requests[i].offset = (off_t)i * PAGE_SIZE;
+    }
+    engine.run(requests);
+    for (auto & request : requests)
+        EXPECT_EQ(request.result, PAGE_SIZE);
+
+    std::vector<std::string> loaded(n, std::string(PAGE_SIZE, '\0'));
+    for (int i = 0; i < n; ++i)
+    {
+        requests[i].type = PageRequest::Type::READ;
+        requests[i].buffer = &loaded[n - 1 - i][0];
+        requests[i].offset = (off_t)(n - 1 - i) * PAGE_SIZE;
+        requests[i].result = -1;
+    }
+    engine.run(requests);
+
+    for (int i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(requests[i].result, PAGE_SIZE);
+        EXPECT_EQ(loaded[i], pages[i]);
+    }
+}
+
+TEST(page_io, default_engine_batch)
+{
+    int fd = open("/tmp/page_io_default_engine", O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+    ASSERT_GE(fd, 0);
+
+    // more requests than the queue depth
+    auto engine = AsyncPageIO::create(fd, 8, 2);
+    printf("engine: %s\n", engine->name());
+    write_then_read_batch(*engine, 100);
+
+    engine.reset();
+    close(fd);
+}
+
+TEST(page_io, thread_pool_batch)
+{
+    int fd = open("/tmp/page_io_thread_pool", O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+    ASSERT_GE(fd, 0);
+
+    ThreadPoolPageIO engine(fd, 3);
+    write_then_read_batch(engine, 100);
+    close(fd);
+}
+
+TEST(page_io, short_read_at_eof)
+{
+    int fd = open("/tmp/page_io_short_read", O_RDWR | O_CREAT | O_TRUNC, S_IWUSR | S_IRUSR);
+    ASSERT_GE(fd, 0);
+    std::string content(100, 'x');
+    write_buffer_at(fd, content.data(), content.size(), 0);
+
+    auto engine = AsyncPageIO::create(fd, 4, 1);
+    std::string page(PAGE_SIZE, '\0');
+    std::vector<PageRequest> requests(1);
+    requests[0].type = PageRequest::Type::READ;
+    requests[0].buffer = &page[0];
+    requests[0].length = PAGE_SIZE;
+    requests[0].offset = 0;
+    engine->run(requests);
+
+    EXPECT_EQ(requests[0].result, 100);
+    EXPECT_EQ(page.substr(0, 100), content);
+
+    engine.reset();
+    close(fd);
+}
+
+TEST(page_io, btree_with_async_pager)
+{
+    for (auto engine : {IoEngine::ASYNC, IoEngine::THREAD_POOL})
+    {
+        std::string path = "/tmp/btree_with_async_pager";
+        PagerOptions options;
+        options.io_engine = engine;
+        options.pool_pages = 32;
+        int n = 1000;
+
+        BPlusTree * btree = new BPlusTree(path, 'c', UserInfo().get_row_byte(), 4, 6, options);
+        insert_rows(btree, n);
+        delete btree;
+
+        // scans prefetch children through the engine
+        btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, options);
+        EXPECT_TRUE(btree->check_valid());
+        for (int key = 0; key < n; ++key)
+            EXPECT_TRUE(btree->find(key).is_exist);
+        delete btree;
+    }
+}
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 #include <core/row.h>
 #include <core/table.h>
+#include <cstring>
 #include <unistd.h>
 
 // Demonstrate some basic assertions.
@@ -69,6 +70,35 @@ TEST(DbFile, read_write_buffer) {
   delete []buff;
 }
 
+TEST(DbFile, read_write_buffer_at) {
+  int fd = open(
+    "/tmp/read_write_buffer_at",
+    O_RDWR | O_CREAT | O_TRUNC,
+    S_IWUSR | S_IRUSR
+  );
+  EXPECT_GE(fd, 0);
+
+  // write blocks out of order, file offset shall stay at 0
+  char block[PAGE_SIZE];
+  for (int i=3; i >= 0; --i) {
+    memset(block, 'a' + i, PAGE_SIZE);
+    ssize_t nbyte = write_buffer_at(fd, block, PAGE_SIZE, i * PAGE_SIZE);
+    EXPECT_EQ(nbyte, PAGE_SIZE);
+  }
+  EXPECT_EQ(lseek(fd, 0, SEEK_CUR), 0);
+
+  for (int i=0; i < 4; ++i) {
+    ssize_t nbyte = read_buffer_at(fd, block, PAGE_SIZE, i * PAGE_SIZE);
+    EXPECT_EQ(nbyte, PAGE_SIZE);
+    EXPECT_EQ(block[0], 'a' + i);
+    EXPECT_EQ(block[PAGE_SIZE - 1], 'a' + i);
+  }
+
+  // read across EOF returns the remaining bytes
+  EXPECT_EQ(read_buffer_at(fd, block, PAGE_SIZE, 3 * PAGE_SIZE + 10), PAGE_SIZE - 10);
+  close(fd);
+}
+
 TEST(DbFile, read_write_page) {
   // write data with two pages into disk
   int n = PAGE_SIZE + 10;
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <core/row.h>
+#include <gtest/gtest.h>
+
+// i-th key of a scrambled order of [0, n), n shall not be a multiple of 7919
+inline int scrambled_key(int i, int n)
+{
+    return (int)(((int64_t)i * 7919) % n);
+}
+
+// insert the rows of the keys stride * scrambled_key(i, n) + offset for i
+// in [begin, end), a row holds its key as id and as name
+template <typename Tree>
+void insert_rows_between(Tree * btree, int begin, int end, int n, int stride = 1, int offset = 0)
+{
+    for (int i = begin; i < end; ++i)
+    {
+        int key = stride * scrambled_key(i, n) + offset;
+        std::string name = std::to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        ASSERT_EQ(btree->insert(key, &row), Tree::InsertStatus::SUCCESS) << key;
+    }
+}
+
+// n rows in a scrambled order, e.g. stride 2 gives the even keys below 2n
+template <typename Tree>
+void insert_rows(Tree * btree, int n, int stride = 1, int offset = 0)
+{
+    insert_rows_between(btree, 0, n, n, stride, offset);
+}
@@ -0,0 +1,63 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <core/thread_pool.h>
+#include <gtest/gtest.h>
+
+TEST(thread_pool, runs_every_task_once)
+{
+    WorkStealingPool pool(4);
+    EXPECT_EQ(pool.num_threads(), 4u);
+    pool.run(0, [](unsigned, size_t) { FAIL(); });
+
+    // more jobs on the same threads, fewer tasks than threads too
+    for (size_t n : {1, 3, 1000})
+    {
+        std::vector<std::atomic<int>> runs(n);
+        std::atomic<bool> worker_in_range(true);
+        pool.run(n, [&](unsigned worker, size_t task) {
+            if (worker >= pool.num_threads())
+                worker_in_range.store(false);
+            runs[task] += 1;
+        });
+        EXPECT_TRUE(worker_in_range.load());
+        for (auto & count : runs)
+            EXPECT_EQ(count.load(), 1);
+    }
+}
+
+TEST(thread_pool, idle_threads_steal)
+{
+    // the block of worker 0 takes long, the others steal its tasks
+    WorkStealingPool pool(2);
+    std::vector<unsigned> worker_of(64);
+    pool.run(worker_of.size(), [&](unsigned worker, size_t task) {
+        worker_of[task] = worker;
+        if (worker == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+
+    int stolen = 0;
+    for (size_t task = 0; task < worker_of.size() / 2; ++task)
+        stolen += worker_of[task] != 0;
+    EXPECT_GT(stolen, 0);
+}
+
+TEST(thread_pool, task_error_is_thrown_by_run)
+{
+    WorkStealingPool pool(3);
+    std::atomic<int> num_run(0);
+    EXPECT_THROW(pool.run(100, [&](unsigned, size_t task) {
+        num_run += 1;
+        if (task == 10)
+            throw std::runtime_error("task failed");
+    }), std::runtime_error);
+    EXPECT_LE(num_run.load(), 100);
+
+    // the pool is usable after a failed job
+    num_run = 0;
+    pool.run(100, [&](unsigned, size_t) { num_run += 1; });
+    EXPECT_EQ(num_run.load(), 100);
+}
@@ -0,0 +1,367 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <core/btree.h>
+#include <core/dbfile.h>
+#include <core/row.h>
+#include <core/wal.h>
+#include <gtest/gtest.h>
+#include "test_rows.h"
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static WalOptions wal_enabled(size_t group_commit_size = 32)
+{
+    WalOptions options;
+    options.enabled = true;
+    options.group_commit_size = group_commit_size;
+    options.group_commit_interval = std::chrono::seconds(10);
+    return options;
+}
+
+static PagerOptions small_pool()
+{
+    PagerOptions options;
+    options.pool_pages = 32;
+    return options;
+}
+
+static long file_size(const std::string & path)
+{
+    struct stat buf;
+    if (stat(path.c_str(), &buf) < 0)
+        return -1;
+    return buf.st_size;
+}
+
+TEST(wal, append_and_replay)
+{
+    std::string path = "/tmp/wal_append_and_replay";
+    {
+        WriteAheadLog wal(path, 'c', wal_enabled(2));
+        for (int i = 0; i < 5; ++i)
+        {
+            WalGroup group;
+            group.num_pages = i;
+            group.records.push_back({WalRecordType::PAGE_IMAGE, (uint64_t)i, std::string(10 * i, 'a' + i)});
+            EXPECT_EQ(wal.append(group), (uint64_t)i + 1);
+        }
+        // two groups of two are synced, the fifth one is pending
+        EXPECT_EQ(wal.durable_lsn(), 5u);
+    }
+
+    // a torn frame at the end is cut off
+    long size = file_size(path);
+    int fd = open(path.c_str(), O_WRONLY);
+    ASSERT_GE(fd, 0);
+    uint32_t torn[2] = {1000, 0};
+    write_buffer_at(fd, torn, sizeof(torn), size);
+    close(fd);
+
+    WriteAheadLog wal(path, 'o', wal_enabled());
+    int num_groups = 0;
+    wal.replay(
+        [&num_groups](const WalGroup & group)
+        {
+            EXPECT_EQ(group.lsn, (uint64_t)num_groups + 1);
+            EXPECT_EQ(group.num_pages, (uint64_t)num_groups);
+            ASSERT_EQ(group.records.size(), 1u);
+            EXPECT_EQ(group.records[0].payload, std::string(10 * num_groups, 'a' + num_groups));
+            num_groups += 1;
+        });
+
+    EXPECT_EQ(num_groups, 5);
+    EXPECT_EQ(wal.next_lsn(), 6u);
+    EXPECT_EQ(file_size(path), size);
+}
+
+TEST(wal, torn_length_past_end)
+{
+    std::string path = "/tmp/wal_torn_length_past_end";
+    {
+        WriteAheadLog wal(path, 'c', wal_enabled());
+        for (int i = 0; i < 3; ++i)
+        {
+            WalGroup group;
+            group.records.push_back({WalRecordType::PAGE_IMAGE, (uint64_t)i, std::string(100, 'a')});
+            wal.append(group);
+        }
+    }
+
+    // a huge length is cut off without reading a payload of that size, so is
+    // a length too small for the group header
+    long size = file_size(path);
+    for (uint32_t length : {0x7fffffffu, 3u})
+    {
+        int fd = open(path.c_str(), O_WRONLY);
+        ASSERT_GE(fd, 0);
+        uint32_t torn[2] = {length, 0};
+        write_buffer_at(fd, torn, sizeof(torn), size);
+        write_buffer_at(fd, "garbage", 7, size + sizeof(torn));
+        close(fd);
+
+        WriteAheadLog wal(path, 'o', wal_enabled());
+        int num_groups = 0;
+        wal.replay([&num_groups](const WalGroup &) { num_groups += 1; });
+        EXPECT_EQ(num_groups, 3);
+        EXPECT_EQ(wal.next_lsn(), 4u);
+        EXPECT_EQ(file_size(path), size);
+    }
+}
+
+TEST(wal, reset_keeps_lsn)
+{
+    std::string path = "/tmp/wal_reset_keeps_lsn";
+    {
+        WriteAheadLog wal(path, 'c', wal_enabled());
+        for (int i = 0; i < 3; ++i)
+        {
+            WalGroup group;
+            group.records.push_back({WalRecordType::PAGE_IMAGE, (uint64_t)i, std::string(100, 'a')});
+            wal.append(group);
+        }
+        wal.reset();
+        EXPECT_EQ(wal.first_lsn(), 4u);
+    }
+
+    // the log is replaced by a header at once, it is never empty on disk
+    EXPECT_EQ(file_size(path), (long)(2 * sizeof(uint64_t)));
+    WriteAheadLog wal(path, 'o', wal_enabled());
+    EXPECT_EQ(wal.next_lsn(), 4u);
+    wal.replay([](const WalGroup &) { FAIL(); });
+}
+
+TEST(wal, committed_inserts_survive_crash)
+{
+    std::string path = "/tmp/wal_committed_inserts_survive_crash";
+    int n = 2000, committed = 1500;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        // the child dies without closing the tree: nothing but the log
+        // and evicted pages reach the file
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+        insert_rows_between(&btree, 0, committed, n);
+        btree.commit();
+        insert_rows_between(&btree, committed, committed + 10, n);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    BPlusTree * btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree->check_valid());
+    for (int i = 0; i < committed; ++i)
+    {
+        int key = scrambled_key(i, n);
+        auto location = btree->find(key);
+        ASSERT_TRUE(location.is_exist) << key;
+    }
+
+    // recovered tree keeps working and the checkpoint empties the log
+    insert_rows_between(btree, committed + 10, n, n);
+    delete btree;
+    EXPECT_EQ(file_size(path + "-wal"), 2 * (long)sizeof(uint64_t));
+
+    btree = new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree->check_valid());
+    for (int i = committed + 10; i < n; ++i)
+        EXPECT_TRUE(btree->find(scrambled_key(i, n)).is_exist);
+    delete btree;
+}
+
+TEST(wal, replay_is_idempotent)
+{
+    std::string path = "/tmp/wal_replay_is_idempotent";
+    int n = 500;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled(1));
+        insert_rows(&btree, n);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+
+    // keep a copy of the log, replay it twice over the same file
+    std::string log = path + "-wal";
+    std::string copy = path + "-wal-copy";
+    ASSERT_EQ(system(("cp " + log + " " + copy).c_str()), 0);
+
+    delete new BPlusTree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    ASSERT_EQ(system(("cp " + copy + " " + log).c_str()), 0);
+
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree.check_valid());
+    for (int key = 0; key < n; ++key)
+        EXPECT_TRUE(btree.find(key).is_exist);
+}
+
+TEST(wal, fuzzy_checkpoint_bounds_log)
+{
+    std::string path = "/tmp/wal_fuzzy_checkpoint_bounds_log";
+    int n = 3000;
+
+    PagerOptions pager_options = small_pool();
+    pager_options.pool_pages = 64;
+    pager_options.checkpoint_dirty_pages = 8;
+    pager_options.checkpoint_step_pages = 4;
+    WalOptions wal_options = wal_enabled(8);
+    wal_options.checkpoint_bytes = 64 << 10;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, pager_options, wal_options);
+        insert_rows(&btree, n);
+        btree.commit();
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    // dirty pages are written while inserting, so old groups are dropped
+    EXPECT_LT(file_size(path + "-wal"), 256 << 10);
+
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 4, 6, pager_options, wal_options);
+    EXPECT_TRUE(btree.check_valid());
+    for (int key = 0; key < n; ++key)
+        ASSERT_TRUE(btree.find(key).is_exist) << key;
+}
+
+TEST(wal, bulk_load_is_durable)
+{
+    std::string path = "/tmp/wal_bulk_load_is_durable";
+    int n = 3000;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+        int i = 0;
+        UserInfo row;
+        btree.bulk_load(
+            [&i, n, &row](uint32_t & key, Row *& out)
+            {
+                if (i == n)
+                    return false;
+                key = i++;
+                std::string name = std::to_string(key);
+                row = UserInfo(key, name.c_str(), name.c_str());
+                out = &row;
+                return true;
+            },
+            0.8);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree.check_valid());
+    for (int key = 0; key < n; ++key)
+        ASSERT_TRUE(btree.find(key).is_exist) << key;
+}
+
+TEST(wal, committed_removes_survive_crash)
+{
+    std::string path = "/tmp/wal_committed_removes_survive_crash";
+    int n = 2000;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        // merges and freed pages reach the file through the log only
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+        insert_rows(&btree, n);
+        btree.commit();
+        for (int key = 0; key < n; key += 2)
+            btree.remove(key);
+        btree.remove_range(1000, 1499);
+        btree.commit();
+        btree.remove_range(1500, 1600);
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree.check_valid());
+    for (int key = 0; key < n; ++key)
+    {
+        if (key >= 1500 && key <= 1600)
+            continue;
+        bool removed = key % 2 == 0 || (key >= 1000 && key < 1500);
+        ASSERT_EQ(btree.find(key).is_exist, !removed) << key;
+    }
+
+    // pages on the free list are handed out again
+    auto num_pages = btree.get_total_page();
+    for (int key = 0; key < 1000; key += 2)
+    {
+        std::string name = std::to_string(key);
+        UserInfo row(key, name.c_str(), name.c_str());
+        ASSERT_EQ(btree.insert(key, &row), BPlusTree::InsertStatus::SUCCESS);
+    }
+    EXPECT_TRUE(btree.check_valid());
+    EXPECT_EQ(btree.get_total_page(), num_pages);
+}
+
+TEST(wal, batch_inserts_survive_crash)
+{
+    std::string path = "/tmp/wal_batch_inserts_survive_crash";
+    int n = 3000;
+
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0)
+    {
+        // large batches change more pages than the pool holds
+        std::vector<UserInfo> rows(n);
+        std::vector<BPlusTree::BatchEntry> batch;
+        for (int key = 0; key < n; ++key)
+        {
+            std::string name = std::to_string(key);
+            rows[key] = UserInfo(key, name.c_str(), name.c_str());
+            batch.push_back({(uint32_t)key, &rows[key]});
+        }
+        BPlusTree btree(path, 'c', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+        btree.insert_batch(std::vector<BPlusTree::BatchEntry>(batch.begin(), batch.begin() + 2000));
+        btree.commit();
+        btree.insert_batch(std::vector<BPlusTree::BatchEntry>(batch.begin() + 2000, batch.end()));
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(WEXITSTATUS(status), 0);
+
+    BPlusTree btree(path, 'o', UserInfo().get_row_byte(), 4, 6, small_pool(), wal_enabled());
+    EXPECT_TRUE(btree.check_valid());
+    for (int key = 0; key < 2000; ++key)
+        ASSERT_TRUE(btree.find(key).is_exist) << key;
+}